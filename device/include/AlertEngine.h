@@ -0,0 +1,327 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <ArduinoJson.h>
+
+// Min, max and mean over a sliding time window, maintained incrementally:
+// monotonic queues for the extremes and a running sum for the mean, so each
+// sample costs amortised O(1) regardless of window length. Samples closer
+// together than window / (Capacity - 2) share a bucket, so the window holds
+// its full length however fast its sensor updates.
+template <size_t Capacity>
+class RollingWindow
+{
+public:
+	void setWindow(uint32_t windowMs)
+	{
+		window = windowMs;
+		bucketMs = windowMs ? windowMs / (Capacity - 2) + 1 : 0;
+	}
+
+	void add(float value, uint32_t nowMs)
+	{
+		if (!started)
+		{
+			started = true;
+			startedAt = nowMs;
+		}
+
+		sum += value;
+		++total;
+		if (count && nowMs - samples[(nextSeq - 1) % Capacity].first < bucketMs)
+		{
+			// Fold into the newest bucket, which is always last in both queues
+			const uint32_t seq = nextSeq - 1;
+			Sample& bucket = samples[seq % Capacity];
+			bucket.min = value < bucket.min ? value : bucket.min;
+			bucket.max = value > bucket.max ? value : bucket.max;
+			bucket.sum += value;
+			++bucket.count;
+			bucket.last = nowMs;
+			--minCount;
+			--maxCount;
+			push(seq);
+			expire(nowMs);
+			return;
+		}
+
+		if (count == Capacity)
+		{
+			popFront(); // Unreachable with buckets sized to the window; kept as a guard
+		}
+
+		const uint32_t seq = nextSeq++;
+		samples[seq % Capacity] = {value, value, value, 1, nowMs, nowMs};
+		++count;
+		push(seq);
+		expire(nowMs);
+	}
+
+	void expire(uint32_t nowMs)
+	{
+		while (count > 1 && nowMs - samples[(nextSeq - count) % Capacity].last > window)
+		{
+			popFront();
+		}
+	}
+
+	float min() const { return count ? samples[minQueue[minHead] % Capacity].min : NAN; }
+	float max() const { return count ? samples[maxQueue[maxHead] % Capacity].max : NAN; }
+	float mean() const { return total ? (float)(sum / total) : NAN; }
+	size_t size() const { return count; }
+
+	// True once samples have been observed for at least one full window
+	bool covers(uint32_t nowMs) const
+	{
+		return started && nowMs - startedAt >= window;
+	}
+
+	void clear()
+	{
+		count = minCount = maxCount = 0;
+		minHead = maxHead = 0;
+		sum = 0;
+		total = 0;
+		started = false;
+	}
+
+private:
+	struct Sample
+	{
+		float min;
+		float max;
+		float sum;
+		uint32_t count;
+		uint32_t first; // Timestamps of the bucket's first and last samples
+		uint32_t last;
+	};
+
+	std::array<Sample, Capacity> samples = {};
+	std::array<uint32_t, Capacity> minQueue = {};
+	std::array<uint32_t, Capacity> maxQueue = {};
+	uint32_t nextSeq = 0;
+	size_t count = 0;
+	size_t minHead = 0, minCount = 0;
+	size_t maxHead = 0, maxCount = 0;
+	double sum = 0;
+	uint32_t total = 0;
+	uint32_t window = 0;
+	uint32_t bucketMs = 0;
+	uint32_t startedAt = 0;
+	bool started = false;
+
+	void push(uint32_t seq)
+	{
+		const Sample& sample = samples[seq % Capacity];
+		while (minCount > 0 && samples[minQueue[(minHead + minCount - 1) % Capacity] % Capacity].min >= sample.min)
+		{
+			--minCount;
+		}
+		minQueue[(minHead + minCount++) % Capacity] = seq;
+
+		while (maxCount > 0 && samples[maxQueue[(maxHead + maxCount - 1) % Capacity] % Capacity].max <= sample.max)
+		{
+			--maxCount;
+		}
+		maxQueue[(maxHead + maxCount++) % Capacity] = seq;
+	}
+
+	void popFront()
+	{
+		const uint32_t seq = nextSeq - count;
+		sum -= samples[seq % Capacity].sum;
+		total -= samples[seq % Capacity].count;
+		--count;
+		if (minCount > 0 && minQueue[minHead] == seq)
+		{
+			minHead = (minHead + 1) % Capacity;
+			--minCount;
+		}
+		if (maxCount > 0 && maxQueue[maxHead] == seq)
+		{
+			maxHead = (maxHead + 1) % Capacity;
+			--maxCount;
+		}
+	}
+};
+
+struct AlertRule
+{
+	enum Stat : uint8_t
+	{
+		Value,
+		Min,
+		Max,
+		Mean,
+	};
+
+	char name[24];
+	Stat stat;
+	bool above;        // Fire when the statistic is above (true) or below (false) the threshold
+	bool active;
+	float threshold;
+	float hysteresis;  // Distance back past the threshold required to clear
+	float statistic;   // At the last evaluation
+	uint32_t windowMs;
+	int8_t next;       // Next rule on the same topic, -1 terminates the chain
+};
+
+using AlertListener = std::function<void(const AlertRule& rule, float statistic)>;
+
+// Threshold alerts over sensor values, e.g. "freezer above -10 for 5 min" is
+// {"stat":"min","window":300,"op":">","threshold":-10}. Rules are compiled from
+// a JSON config into a fixed table chained per state topic, so an update only
+// touches the rules watching that topic.
+class AlertEngine
+{
+public:
+	static constexpr size_t MaxRules = 8;
+	static constexpr size_t WindowSamples = 64;
+
+	void setListener(const AlertListener listener)
+	{
+		onChange = listener;
+	}
+
+	// {"rules":[{"name":"freezer_warm","topic":"...","stat":"min","window":300,"op":">","threshold":-10,"hysteresis":1}]}
+	// Alerts active under the old rules are cleared through the listener first,
+	// so nothing stays raised in HA for a rule that no longer exists
+	bool compile(const std::string& json)
+	{
+		for (size_t i = 0; i < ruleCount; ++i)
+		{
+			if (rules[i].active)
+			{
+				rules[i].active = false;
+				if (onChange)
+				{
+					onChange(rules[i], rules[i].statistic);
+				}
+			}
+		}
+		ruleCount = 0;
+		firstByTopic.clear();
+
+		JsonDocument doc;
+		if (deserializeJson(doc, json))
+		{
+			return false;
+		}
+
+		for (JsonObject source : doc["rules"].as<JsonArray>())
+		{
+			const char* topic = source["topic"] | "";
+			if (ruleCount == MaxRules || *topic == '\0')
+			{
+				continue;
+			}
+
+			AlertRule& rule = rules[ruleCount];
+			rule = {};
+			strncpy(rule.name, source["name"] | "alert", sizeof(rule.name) - 1);
+			rule.stat = parseStat(source["stat"] | "value");
+			rule.above = strcmp(source["op"] | ">", "<") != 0;
+			rule.threshold = source["threshold"] | 0.0f;
+			rule.hysteresis = fabsf(source["hysteresis"] | 0.0f);
+			rule.windowMs = (source["window"] | 0u) * 1000u;
+
+			windows[ruleCount].clear();
+			windows[ruleCount].setWindow(rule.windowMs);
+
+			auto first = firstByTopic.find(topic);
+			rule.next = first == firstByTopic.end() ? -1 : first->second;
+			firstByTopic[topic] = (int8_t)ruleCount;
+			++ruleCount;
+		}
+
+		return true;
+	}
+
+	void onValue(const std::string& topic, float value, uint32_t nowMs)
+	{
+		auto first = firstByTopic.find(topic);
+		if (first == firstByTopic.end())
+		{
+			return;
+		}
+
+		for (int8_t i = first->second; i >= 0; i = rules[i].next)
+		{
+			AlertRule& rule = rules[i];
+			RollingWindow<WindowSamples>& window = windows[i];
+			window.add(value, nowMs);
+
+			// Windowed rules only decide once they have seen a full window
+			if (!window.covers(nowMs))
+			{
+				continue;
+			}
+
+			const float statistic = statisticOf(rule, window, value);
+			rule.statistic = statistic;
+			const bool firing = rule.above ? statistic > rule.threshold : statistic < rule.threshold;
+			const bool clear = rule.above ? statistic <= rule.threshold - rule.hysteresis : statistic >= rule.threshold + rule.hysteresis;
+
+			if ((!rule.active && firing) || (rule.active && clear))
+			{
+				rule.active = !rule.active;
+				if (onChange)
+				{
+					onChange(rule, statistic);
+				}
+			}
+		}
+	}
+
+	bool anyActive() const
+	{
+		for (size_t i = 0; i < ruleCount; ++i)
+		{
+			if (rules[i].active)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t size() const
+	{
+		return ruleCount;
+	}
+
+private:
+	std::array<AlertRule, MaxRules> rules = {};
+	std::array<RollingWindow<WindowSamples>, MaxRules> windows;
+	std::unordered_map<std::string, int8_t> firstByTopic;
+	size_t ruleCount = 0;
+	AlertListener onChange;
+
+	static AlertRule::Stat parseStat(const char* stat)
+	{
+		if (strcmp(stat, "min") == 0) return AlertRule::Min;
+		if (strcmp(stat, "max") == 0) return AlertRule::Max;
+		if (strcmp(stat, "mean") == 0) return AlertRule::Mean;
+		return AlertRule::Value;
+	}
+
+	static float statisticOf(const AlertRule& rule, const RollingWindow<WindowSamples>& window, float value)
+	{
+		switch (rule.stat)
+		{
+		case AlertRule::Min:
+			return window.min();
+		case AlertRule::Max:
+			return window.max();
+		case AlertRule::Mean:
+			return window.mean();
+		default:
+			return value;
+		}
+	}
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Opt-in heap allocation attribution: with -D CYD_ALLOC_TRACK (and malloc,
+// calloc and realloc wrapped at link time, see platformio.ini) every
+// operator new and C allocation made on the main task is counted against the
+// innermost ALLOC_SCOPE() open at the time. Allocations from other tasks
+// (WiFi, lwIP) land in "other_tasks". Without the flag the macros expand to
+// nothing and src/AllocTracking.cpp compiles to an empty object.
+//
+// -D CYD_NO_HEAP_AFTER_BOOT builds on it for the wall panel mode: once setup()
+// calls seal(), a main task allocation outside an ALLOC_PERMIT() region counts
+// as a violation, and with CYD_NO_HEAP_AFTER_BOOT=2 it aborts on the spot so
+// the backtrace shows the caller. Permits cover the event-driven paths that
+// legitimately allocate (reconnecting, new configs, flash writes), not the
+// per-message path.
+#if defined(CYD_NO_HEAP_AFTER_BOOT) && !defined(CYD_ALLOC_TRACK)
+#define CYD_ALLOC_TRACK
+#endif
+
+namespace AllocTracker
+{
+	enum Scope : uint8_t
+	{
+		Unscoped,   // Main task, outside any scope
+		OtherTasks,
+		MqttLoop,   // client.loop() outside dispatch: PubSubClient, TLS, transport
+		Dispatch,   // MQTTDispatcher matching and payload copies
+		Handler,    // Registered handlers
+		Render,     // render_dirty_sensors() and the other widget updates
+		Lvgl,       // lv_timer_handler(): layout, drawing, LVGL's own allocations
+		Provisioning,
+		Publish,
+		ScopeCount,
+	};
+
+	inline const char* name(uint8_t scope)
+	{
+		static const char* const names[ScopeCount] = {"unscoped", "other_tasks", "mqtt_loop", "dispatch", "handler",
+		                                              "render", "lvgl", "provisioning", "publish"};
+		return scope < ScopeCount ? names[scope] : "?";
+	}
+
+	struct Totals
+	{
+		uint32_t count;
+		uint32_t bytes;
+	};
+
+	// Implemented in src/AllocTracking.cpp
+	Scope enter(Scope scope); // Returns the scope to restore
+	void leave(Scope previous);
+	Totals totals(Scope scope);
+	uint32_t frees();
+	void reset();
+
+	void seal(); // End of boot: from here on unpermitted allocations are violations
+	void permit(bool allowed);
+	bool permitted();
+	uint32_t violations();
+	Scope lastViolation(); // Scope of the most recent violation
+
+	// {"scopes":{"dispatch":{"count":n,"bytes":n},...},"frees":n,"after_boot":n,"last_violation":"handler"}
+	inline size_t toJson(char* out, size_t size)
+	{
+		size_t used = (size_t)snprintf(out, size, "{\"scopes\":{");
+		for (uint8_t scope = 0; scope < ScopeCount && used < size; ++scope)
+		{
+			const Totals t = totals((Scope)scope);
+			used += (size_t)snprintf(out + used, size - used, "%s\"%s\":{\"count\":%u,\"bytes\":%u}", scope ? "," : "", name(scope),
+			                         (unsigned)t.count, (unsigned)t.bytes);
+		}
+		if (used < size)
+		{
+			used += (size_t)snprintf(out + used, size - used, "},\"frees\":%u,\"after_boot\":%u,\"last_violation\":\"%s\"}",
+			                         (unsigned)frees(), (unsigned)violations(), violations() ? name(lastViolation()) : "");
+		}
+		return used < size ? used : 0;
+	}
+
+	class ScopeGuard
+	{
+	public:
+		explicit ScopeGuard(Scope scope) : previous(enter(scope)) {}
+		~ScopeGuard() { leave(previous); }
+
+	private:
+		Scope previous;
+	};
+
+	class PermitGuard
+	{
+	public:
+		PermitGuard() : previous(permitted()) { permit(true); }
+		~PermitGuard() { permit(previous); }
+
+	private:
+		bool previous;
+	};
+}
+
+#ifdef CYD_ALLOC_TRACK
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_SCOPE(scope) AllocTracker::ScopeGuard ALLOC_CONCAT(allocScope, __LINE__)(AllocTracker::scope)
+#define ALLOC_PERMIT() AllocTracker::PermitGuard ALLOC_CONCAT(allocPermit, __LINE__)
+#else
+#define ALLOC_SCOPE(scope)
+#define ALLOC_PERMIT()
+#endif
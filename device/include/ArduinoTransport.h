@@ -0,0 +1,152 @@
+#pragma once
+#include <Client.h>
+#include "Transport.h"
+
+// Transport over an Arduino Client: WiFiClient, or TlsClient wrapping one.
+class ClientTransport : public Transport
+{
+public:
+	explicit ClientTransport(Client& client) : client(client)
+	{
+	}
+
+	bool open(const char* host, uint16_t port) override
+	{
+		return client.connect(host, port) == 1;
+	}
+
+	void close() override
+	{
+		client.stop();
+	}
+
+	bool isOpen() override
+	{
+		return client.connected();
+	}
+
+	size_t send(const uint8_t* data, size_t length) override
+	{
+		return client.write(data, length);
+	}
+
+	int receive(uint8_t* data, size_t length) override
+	{
+		if (client.available() <= 0)
+		{
+			return client.connected() ? 0 : -1;
+		}
+		int n = client.read(data, length);
+		return n > 0 ? n : 0;
+	}
+
+	size_t pending() override
+	{
+		int n = client.available();
+		return n > 0 ? (size_t)n : 0;
+	}
+
+private:
+	Client& client;
+};
+
+// The other direction: presents any Transport as the Arduino Client that
+// PubSubClient and StreamingClient expect, so the MQTT stack does not care
+// which transport it is running over.
+class TransportClient : public Client
+{
+public:
+	explicit TransportClient(Transport& transport) : transport(&transport)
+	{
+	}
+
+	// Swaps the transport; only while disconnected
+	void setTransport(Transport& next)
+	{
+		transport = &next;
+	}
+
+	int connect(IPAddress ip, uint16_t port) override
+	{
+		peeked = -1;
+		return transport->open(ip.toString().c_str(), port) ? 1 : 0;
+	}
+
+	int connect(const char* host, uint16_t port) override
+	{
+		peeked = -1;
+		return transport->open(host, port) ? 1 : 0;
+	}
+
+	size_t write(uint8_t b) override
+	{
+		return transport->send(&b, 1);
+	}
+
+	size_t write(const uint8_t* buf, size_t size) override
+	{
+		return transport->send(buf, size);
+	}
+
+	int available() override
+	{
+		return (int)transport->pending() + (peeked >= 0 ? 1 : 0);
+	}
+
+	int read() override
+	{
+		uint8_t b;
+		return read(&b, 1) == 1 ? b : -1;
+	}
+
+	int read(uint8_t* buf, size_t size) override
+	{
+		if (size == 0)
+		{
+			return 0;
+		}
+		size_t copied = 0;
+		if (peeked >= 0)
+		{
+			buf[copied++] = (uint8_t)peeked;
+			peeked = -1;
+		}
+		int n = copied < size ? transport->receive(buf + copied, size - copied) : 0;
+		copied += n > 0 ? n : 0;
+		return copied > 0 ? (int)copied : -1;
+	}
+
+	int peek() override
+	{
+		if (peeked < 0)
+		{
+			uint8_t b;
+			peeked = transport->receive(&b, 1) == 1 ? b : -1;
+		}
+		return peeked;
+	}
+
+	void flush() override
+	{
+	}
+
+	void stop() override
+	{
+		peeked = -1;
+		transport->close();
+	}
+
+	uint8_t connected() override
+	{
+		return transport->isOpen() || peeked >= 0 || transport->pending() > 0;
+	}
+
+	operator bool() override
+	{
+		return transport->isOpen();
+	}
+
+private:
+	Transport* transport;
+	int peeked = -1;
+};
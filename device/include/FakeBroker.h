@@ -0,0 +1,226 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "MqttPacket.h"
+#include "Transport.h"
+
+// Scripted MQTT broker for the server end of a LoopbackLink. Answers
+// CONNECT, SUBSCRIBE and PINGREQ, keeps retained messages, records what the
+// client publishes, and lets a test publish to the client. Single client,
+// QoS 0/1. A session opened with clean session off is kept while the client is
+// away and queues its QoS 1 messages, up to maxQueued like mosquitto's
+// max_queued_messages; QoS 0 is not queued, as in mosquitto's default.
+class FakeBroker
+{
+public:
+	struct Message
+	{
+		std::string topic;
+		std::string payload;
+		bool retained;
+	};
+
+	explicit FakeBroker(Transport& transport, size_t maxQueued = 1000) : transport(transport), maxQueued(maxQueued)
+	{
+	}
+
+	// Processes whatever the client has sent so far
+	void poll()
+	{
+		uint8_t buffer[512];
+		int n;
+		while ((n = transport.receive(buffer, sizeof(buffer))) > 0)
+		{
+			size_t offset = 0;
+			while (offset < (size_t)n)
+			{
+				offset += reader.feed(buffer + offset, n - offset);
+				if (reader.complete())
+				{
+					handle();
+				}
+			}
+		}
+	}
+
+	// Delivers to the client if a subscription matches; retained messages are also kept for later subscribers
+	void publish(const std::string& topic, const std::string& payload, bool retained = false, uint8_t qos = 0)
+	{
+		if (retained)
+		{
+			if (payload.empty())
+			{
+				retainedMessages.erase(topic);
+			}
+			else
+			{
+				retainedMessages[topic] = payload;
+			}
+		}
+		const int granted = grantedQos(topic);
+		if (granted < 0)
+		{
+			return;
+		}
+		const uint8_t delivered = qos < granted ? qos : (uint8_t)granted;
+		if (transport.isOpen())
+		{
+			send(MqttPacket::publish(topic, (const uint8_t*)payload.data(), payload.size(), delivered, false, nextPacketId()));
+		}
+		else if (persistent && delivered > 0)
+		{
+			if (queued.size() < maxQueued)
+			{
+				queued.push_back({topic, payload, false});
+			}
+			else
+			{
+				++queueDropped;
+			}
+		}
+	}
+
+	const std::vector<std::string>& subscriptions() const { return filters; }
+	const std::vector<Message>& published() const { return received; }
+	size_t connects() const { return connectCount; }
+	size_t subscribePackets() const { return subscribeCount; }
+	size_t queuedMessages() const { return queued.size(); }
+	size_t queueOverflow() const { return queueDropped; }
+
+	void clearPublished()
+	{
+		received.clear();
+	}
+
+private:
+	Transport& transport;
+	MqttPacket::Reader reader;
+	std::vector<std::string> filters;
+	std::vector<uint8_t> filterQos;
+	std::vector<Message> queued; // For a persistent session while its client is away
+	size_t maxQueued;
+	size_t queueDropped = 0;
+	bool persistent = false;
+	std::map<std::string, std::string> retainedMessages;
+	std::vector<Message> received;
+	size_t connectCount = 0;
+	size_t subscribeCount = 0;
+	uint16_t packetId = 0;
+
+	void handle()
+	{
+		switch (reader.type())
+		{
+		case MqttPacket::Connect:
+		{
+			++connectCount;
+			// Body: protocol name (2 + 4 bytes), level, then the connect flags
+			const bool clean = reader.body().size() < 8 || (reader.body()[7] & 0x02);
+			const bool sessionPresent = !clean && persistent;
+			if (!sessionPresent)
+			{
+				filters.clear();
+				filterQos.clear();
+				queued.clear();
+			}
+			persistent = !clean;
+			send(MqttPacket::connack(sessionPresent, 0));
+			for (const auto& message : queued)
+			{
+				send(MqttPacket::publish(message.topic, (const uint8_t*)message.payload.data(), message.payload.size(), 1, false,
+				                         nextPacketId()));
+			}
+			queued.clear();
+			break;
+		}
+		case MqttPacket::Subscribe:
+		{
+			++subscribeCount;
+			std::vector<uint8_t> qos;
+			auto requested = MqttPacket::subscribeFilters(reader, &qos);
+			for (auto& granted : qos)
+			{
+				granted = granted > 1 ? 1 : granted;
+			}
+			send(MqttPacket::suback(MqttPacket::packetIdOf(reader), qos));
+			for (size_t i = 0; i < requested.size(); ++i)
+			{
+				const std::string& filter = requested[i];
+				size_t existing = 0;
+				while (existing < filters.size() && filters[existing] != filter)
+				{
+					++existing;
+				}
+				if (existing == filters.size())
+				{
+					filters.push_back(filter);
+					filterQos.push_back(qos[i]);
+				}
+				else
+				{
+					filterQos[existing] = qos[i]; // Re-subscribing replaces the subscription
+				}
+				for (const auto& [topic, payload] : retainedMessages)
+				{
+					if (MqttPacket::topicMatches(filter.c_str(), topic.c_str()))
+					{
+						send(MqttPacket::publish(topic, (const uint8_t*)payload.data(), payload.size(), 0, true, 0));
+					}
+				}
+			}
+			break;
+		}
+		case MqttPacket::Publish:
+		{
+			MqttPacket::PublishView view;
+			if (MqttPacket::parsePublish(reader, view))
+			{
+				received.push_back({view.topic, std::string((const char*)view.payload, view.length), view.retained});
+				if (view.qos == 1)
+				{
+					send(MqttPacket::puback(view.packetId));
+				}
+				if (view.retained)
+				{
+					retainedMessages[view.topic] = received.back().payload;
+				}
+			}
+			break;
+		}
+		case MqttPacket::Pingreq:
+			send({MqttPacket::Pingresp << 4, 0});
+			break;
+		case MqttPacket::Disconnect:
+			transport.close();
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Highest QoS granted to a filter matching topic, -1 when none does
+	int grantedQos(const std::string& topic) const
+	{
+		int granted = -1;
+		for (size_t i = 0; i < filters.size(); ++i)
+		{
+			if (MqttPacket::topicMatches(filters[i].c_str(), topic.c_str()) && filterQos[i] > granted)
+			{
+				granted = filterQos[i];
+			}
+		}
+		return granted;
+	}
+
+	void send(const std::vector<uint8_t>& bytes)
+	{
+		transport.send(bytes.data(), bytes.size());
+	}
+
+	uint16_t nextPacketId()
+	{
+		packetId = packetId == 0xFFFF ? 1 : packetId + 1;
+		return packetId;
+	}
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The few board services main.cpp needs, so the same application code runs on
+// the CYD (src/HalEsp32.cpp) and on a Linux host under env:native
+// (native/src/hal_native.cpp). Everything else it uses is plain Arduino API, which
+// the native build provides in native/include.
+namespace hal
+{
+	// Clock
+	uint32_t millis();
+	uint32_t micros();
+	void delay(uint32_t ms);
+	void startTimeSync(const char* ntpServer); // Wall-clock time() becomes valid some time later
+
+	// WiFi
+	void wifiBegin(const char* ssid, const char* password);
+	bool wifiConnected();
+	std::string wifiAddress();
+	std::string macAddress(); // "AA:BB:CC:DD:EE:FF"
+	int wifiRssi();
+
+	// mDNS
+	bool mdnsBegin(const char* hostname);
+	// First instance of _service._proto; false when none answered
+	bool mdnsFind(const char* service, const char* proto, std::string& host, uint16_t& port);
+
+	// Non-volatile key/value storage; returns bytes read, 0 when the key is missing
+	size_t nvsRead(const char* space, const char* key, void* data, size_t length);
+	bool nvsWrite(const char* space, const char* key, const void* data, size_t length);
+
+	// Unused stack of a FreeRTOS task in bytes (its high-water mark since the task
+	// started); -1 when there is no task of that name
+	int32_t stackHighWater(const char* task);
+	// True on the task running setup() and loop(); cheap enough to call from an allocator
+	bool onMainTask();
+
+	// Display
+	void displayBegin();
+	void displayFlush(int32_t x, int32_t y, uint32_t width, uint32_t height, const uint16_t* pixels);
+	void backlight(bool on);
+}
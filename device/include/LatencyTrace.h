@@ -0,0 +1,219 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Log-linear latency histogram in microseconds: four buckets per power of two
+// from 1 us to ~30 s, so percentiles are within 19% and adding is O(1).
+class LatencyHistogram
+{
+public:
+	static constexpr size_t SubBuckets = 4;
+	static constexpr size_t Octaves = 24;
+	static constexpr size_t Buckets = SubBuckets * Octaves;
+
+	void add(uint32_t us)
+	{
+		++buckets[indexOf(us)];
+		++samples;
+		total += us;
+		largest = us > largest ? us : largest;
+	}
+
+	uint32_t count() const { return samples; }
+	uint32_t max() const { return largest; }
+	uint32_t mean() const { return samples ? (uint32_t)(total / samples) : 0; }
+
+	// Upper bound of the bucket holding the p-th sample (0 < p <= 1)
+	uint32_t percentile(float p) const
+	{
+		const uint64_t rank = (uint64_t)(p * samples + 0.5f);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < Buckets; ++i)
+		{
+			seen += buckets[i];
+			if (seen >= rank && seen > 0)
+			{
+				const uint32_t bound = upperBound(i);
+				return bound < largest ? bound : largest;
+			}
+		}
+		return largest;
+	}
+
+	// {"count":n,"mean":us,"p50":us,"p99":us,"max":us,"buckets":{"<upper us>":n,...}}, empty buckets left out
+	size_t toJson(char* out, size_t size) const
+	{
+		size_t used = (size_t)snprintf(out, size, "{\"count\":%u,\"mean\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"buckets\":{",
+		                               (unsigned)samples, (unsigned)mean(), (unsigned)percentile(0.5f), (unsigned)percentile(0.99f), (unsigned)largest);
+		bool first = true;
+		for (size_t i = 0; i < Buckets && used < size; ++i)
+		{
+			if (buckets[i])
+			{
+				used += (size_t)snprintf(out + used, size - used, "%s\"%u\":%u", first ? "" : ",", (unsigned)upperBound(i), (unsigned)buckets[i]);
+				first = false;
+			}
+		}
+		if (used < size)
+		{
+			used += (size_t)snprintf(out + used, size - used, "}}");
+		}
+		return used < size ? used : 0; // 0 when it did not fit
+	}
+
+	void clear()
+	{
+		buckets.fill(0);
+		samples = 0;
+		total = 0;
+		largest = 0;
+	}
+
+	static size_t indexOf(uint32_t us)
+	{
+		if (us < SubBuckets)
+		{
+			return us;
+		}
+		const unsigned octave = 31 - __builtin_clz(us); // >= 2
+		const size_t index = (octave - 1) * SubBuckets + ((us >> (octave - 2)) & (SubBuckets - 1));
+		return index < Buckets ? index : Buckets - 1;
+	}
+
+	static uint32_t upperBound(size_t index)
+	{
+		if (index < SubBuckets)
+		{
+			return (uint32_t)index;
+		}
+		const unsigned octave = (unsigned)(index / SubBuckets) + 1;
+		const uint64_t bound = ((uint64_t)(SubBuckets + index % SubBuckets + 1) << (octave - 2)) - 1;
+		return bound > UINT32_MAX ? UINT32_MAX : (uint32_t)bound;
+	}
+
+private:
+	std::array<uint32_t, Buckets> buckets = {};
+	uint32_t samples = 0;
+	uint64_t total = 0;
+	uint32_t largest = 0;
+};
+
+// Publish-to-pixel latency of messages carrying a send stamp (SendStamp.h),
+// followed through the device in stages:
+//   Network   publisher's clock at send -> mqtt_callback (both clocks NTP-synced)
+//   Dispatch  mqtt_callback -> the handler storing the value for its slot
+//   Render    stored -> widget text set by render_dirty_sensors()
+//   Flush     widget set -> end of the flush that covers the widget's last row
+//   Total     send -> pixels, when the network stage could be measured
+// Values that never reach the screen (superseded by a newer one for the same
+// slot or widget before it was drawn) are counted, not timed.
+template <size_t Slots>
+class LatencyTrace
+{
+public:
+	enum Stage : uint8_t
+	{
+		Network,
+		Dispatch,
+		Render,
+		Flush,
+		Total,
+		StageCount,
+	};
+
+	static const char* stageName(Stage stage)
+	{
+		static const char* const names[StageCount] = {"network", "dispatch", "render", "flush", "total"};
+		return names[stage];
+	}
+
+	// A stamped message arrived; networkUs is negative when it cannot be known (clock not synced or skewed)
+	void received(int64_t networkUs, uint32_t nowUs)
+	{
+		message.active = true;
+		message.networkUs = networkUs;
+		message.receivedUs = nowUs;
+	}
+
+	// The current message's value was stored for slot
+	void dispatched(size_t slot, uint32_t nowUs)
+	{
+		if (!message.active || slot >= Slots)
+		{
+			return;
+		}
+		superseded += pending[slot].active;
+		pending[slot] = message;
+		pending[slot].dispatchedUs = nowUs;
+	}
+
+	// End of mqtt_callback; later handler calls belong to unstamped messages
+	void endMessage()
+	{
+		message.active = false;
+	}
+
+	// The widget now shows slot's value
+	void rendered(size_t slot, uint32_t nowUs)
+	{
+		if (slot >= Slots || !pending[slot].active)
+		{
+			return;
+		}
+		superseded += onWidget.active;
+		onWidget = pending[slot];
+		onWidget.renderedUs = nowUs;
+		pending[slot].active = false;
+	}
+
+	bool awaitingFlush() const { return onWidget.active; }
+
+	// A flush went out; coversWidget when it reached the widget's last row
+	void flushed(bool coversWidget, uint32_t nowUs)
+	{
+		if (!onWidget.active || !coversWidget)
+		{
+			return;
+		}
+		histograms[Dispatch].add(onWidget.dispatchedUs - onWidget.receivedUs);
+		histograms[Render].add(onWidget.renderedUs - onWidget.dispatchedUs);
+		histograms[Flush].add(nowUs - onWidget.renderedUs);
+		if (onWidget.networkUs >= 0)
+		{
+			histograms[Network].add((uint32_t)onWidget.networkUs);
+			histograms[Total].add((uint32_t)onWidget.networkUs + (nowUs - onWidget.receivedUs));
+		}
+		onWidget.active = false;
+	}
+
+	const LatencyHistogram& histogram(Stage stage) const { return histograms[stage]; }
+	uint32_t supersededCount() const { return superseded; }
+
+	// Starts a new reporting interval; values in flight are kept
+	void clear()
+	{
+		for (auto& histogram : histograms)
+		{
+			histogram.clear();
+		}
+		superseded = 0;
+	}
+
+private:
+	struct Trace
+	{
+		bool active;
+		int64_t networkUs;
+		uint32_t receivedUs;
+		uint32_t dispatchedUs;
+		uint32_t renderedUs;
+	};
+
+	Trace message = {};
+	std::array<Trace, Slots> pending = {};
+	Trace onWidget = {};
+	std::array<LatencyHistogram, StageCount> histograms;
+	uint32_t superseded = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <FS.h>
+#include <LittleFS.h>
+#include "TimeSeriesLog.h"
+
+// LogStorage backed by one LittleFS file per segment. LittleFS already spreads
+// writes across the partition; dropping a whole segment file at a time keeps
+// its metadata churn low and the log size bounded.
+class LittleFSLogStorage : public LogStorage
+{
+public:
+	LittleFSLogStorage(uint16_t segments, uint16_t pagesPerSegment) : segments(segments), pages(pagesPerSegment)
+	{
+	}
+
+	uint16_t segmentCount() const override { return segments; }
+	uint16_t pagesPerSegment() const override { return pages; }
+
+	bool readPage(uint16_t segment, uint16_t page, uint8_t* data) override
+	{
+		char path[24];
+		File file = LittleFS.open(pathOf(segment, path, sizeof(path)), "r");
+		if (!file || !file.seek((uint32_t)page * PageSize))
+		{
+			return false;
+		}
+		return file.read(data, PageSize) == PageSize;
+	}
+
+	bool writePage(uint16_t segment, uint16_t page, const uint8_t* data) override
+	{
+		char path[24];
+		pathOf(segment, path, sizeof(path));
+		File file = LittleFS.open(path, LittleFS.exists(path) ? "r+" : "w");
+		if (!file || !file.seek((uint32_t)page * PageSize))
+		{
+			return false;
+		}
+		return file.write(data, PageSize) == PageSize;
+	}
+
+	bool eraseSegment(uint16_t segment) override
+	{
+		char path[24];
+		pathOf(segment, path, sizeof(path));
+		return !LittleFS.exists(path) || LittleFS.remove(path);
+	}
+
+private:
+	uint16_t segments;
+	uint16_t pages;
+
+	static const char* pathOf(uint16_t segment, char* path, size_t size)
+	{
+		snprintf(path, size, "/tslog/%03u.seg", segment);
+		return path;
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <deque>
+#include "Transport.h"
+
+// Two in-memory byte queues joining a pair of transports, one for each end.
+// Lets the MQTT path run against FakeBroker in a single process, with no
+// sockets and no timing other than the order calls are made in.
+class LoopbackLink
+{
+public:
+	class End : public Transport
+	{
+	public:
+		End(LoopbackLink& link, std::deque<uint8_t>& inbound, std::deque<uint8_t>& outbound)
+			: link(link), inbound(inbound), outbound(outbound)
+		{
+		}
+
+		bool open(const char*, uint16_t) override
+		{
+			link.up = true;
+			return true;
+		}
+
+		void close() override
+		{
+			link.up = false;
+			inbound.clear();
+			outbound.clear();
+		}
+
+		bool isOpen() override
+		{
+			return link.up;
+		}
+
+		size_t send(const uint8_t* data, size_t length) override
+		{
+			if (!link.up)
+			{
+				return 0;
+			}
+			outbound.insert(outbound.end(), data, data + length);
+			return length;
+		}
+
+		int receive(uint8_t* data, size_t length) override
+		{
+			if (!link.up && inbound.empty())
+			{
+				return -1;
+			}
+			size_t n = length < inbound.size() ? length : inbound.size();
+			for (size_t i = 0; i < n; ++i)
+			{
+				data[i] = inbound.front();
+				inbound.pop_front();
+			}
+			return (int)n;
+		}
+
+		size_t pending() override
+		{
+			return inbound.size();
+		}
+
+	private:
+		LoopbackLink& link;
+		std::deque<uint8_t>& inbound;
+		std::deque<uint8_t>& outbound;
+	};
+
+	Transport& client() { return clientEnd; }
+	Transport& server() { return serverEnd; }
+
+private:
+	std::deque<uint8_t> toServer;
+	std::deque<uint8_t> toClient;
+	bool up = false;
+	End clientEnd{*this, toClient, toServer};
+	End serverEnd{*this, toServer, toClient};
+};
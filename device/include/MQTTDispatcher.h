@@ -1,71 +1,358 @@
 #pragma once
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <functional>
-#include <sstream>
+#include "PayloadParser.h"
+#include "TopicTokenizer.h"
+#include "TraceRing.h"
+#include "AllocTracker.h"
 
 using Handler = std::function<void(const std::string&, const std::string&)>;
+using ValueHandler = std::function<void(const std::string&, const ParsedPayload&)>;
+using FloatHandler = std::function<void(const std::string&, float)>;
+using IntHandler = std::function<void(const std::string&, int64_t)>;
+using ChunkHandler = std::function<void(const std::string& topic, const uint8_t* data, size_t length, size_t offset, size_t total)>;
 
 class MQTTDispatcher
 {
 public:
 	void registerHandler(const std::string& topicPattern, const Handler handler)
 	{
-		handlers.push_back({split(topicPattern), handler});
+		add({split(topicPattern), handler, nullptr, nullptr});
 	}
 
-	void dispatch(const std::string& topic, const std::string& payload) const
+	// Typed handlers receive the payload parsed once per message, however many of them match.
+	// Sentinels such as "unavailable" reach value handlers only.
+	void registerValueHandler(const std::string& topicPattern, const ValueHandler handler)
 	{
-		auto topicLevels = split(topic);
+		add({split(topicPattern), nullptr, handler, nullptr});
+	}
 
-		for (const auto& [patternLevels, handler] : handlers)
+	void registerFloatHandler(const std::string& topicPattern, const FloatHandler handler)
+	{
+		registerValueHandler(topicPattern, [handler](const std::string& topic, const ParsedPayload& value)
 		{
-			if (match(patternLevels, topicLevels))
+			if (value.kind == ParsedPayload::Number)
 			{
-				handler(topic, payload);
+				handler(topic, (float)value.value);
+			}
+		});
+	}
+
+	void registerIntHandler(const std::string& topicPattern, const IntHandler handler)
+	{
+		registerValueHandler(topicPattern, [handler](const std::string& topic, const ParsedPayload& value)
+		{
+			if (value.isInteger)
+			{
+				handler(topic, value.integer);
 			}
+		});
+	}
+
+	// Chunk handlers see payloads piece by piece as they stream in, so they can
+	// parse messages larger than any buffer. Regular messages arrive as one chunk.
+	void registerChunkHandler(const std::string& topicPattern, const ChunkHandler handler)
+	{
+		add({split(topicPattern), nullptr, nullptr, handler});
+	}
+
+	struct SubscriptionStats
+	{
+		std::string filter;
+		uint32_t received;  // Messages the broker delivered on this filter
+		uint32_t used;      // ...of which at least one handler made use
+	};
+
+	// The smallest set of filters that still delivers every registered pattern:
+	// duplicates and patterns covered by a wider one (a/+/c under a/#) are left
+	// out. Counters survive as long as the registrations don't change.
+	const std::vector<SubscriptionStats>& subscriptions()
+	{
+		if (!filtersStale)
+		{
+			return filters;
 		}
+
+		filters.clear();
+		filterLevels.clear();
+		for (size_t i = 0; i < handlers.size(); ++i)
+		{
+			const auto& candidate = handlers[i].patternLevels;
+			bool redundant = false;
+			for (size_t j = 0; j < handlers.size() && !redundant; ++j)
+			{
+				// Of two identical patterns only the first is kept
+				const auto& other = handlers[j].patternLevels;
+				redundant = j != i && covers(other, candidate) && (j < i || !covers(candidate, other));
+			}
+			if (!redundant)
+			{
+				filters.push_back({join(candidate), 0, 0});
+				filterLevels.push_back(candidate);
+			}
+		}
+		filtersStale = false;
+		return filters;
+	}
+
+	// Called by a handler whose pattern matched but that had no use for the
+	// message (e.g. a state topic nobody discovered), so the filter statistics
+	// show how much of the subscribed traffic is wasted.
+	void ignore()
+	{
+		++ignoredInDispatch;
+	}
+
+	struct LargeMessageStats
+	{
+		uint32_t streamed;  // Delivered to chunk handlers
+		uint32_t pooled;    // Reassembled for regular handlers
+		uint32_t dropped;   // Too large for the pool with no chunk handler to take it
+	};
+
+	static constexpr size_t LargePayloadPool = 4096;
+
+	// Entry point for payloads that arrive in pieces. Chunk handlers get each piece;
+	// other matching handlers get the message whole, reassembled in one pooled
+	// buffer that is only allocated the first time a large message needs it.
+	void dispatchChunk(const std::string& topic, const uint8_t* data, size_t length, size_t offset, size_t total)
+	{
+		TRACE_SCOPE(Dispatch);
+		ALLOC_SCOPE(Dispatch);
+		if (offset == 0)
+		{
+			const TopicLevels topicLevels = levelsOf(topic);
+			chunkTargets.clear();
+			bool used = false;
+			needsWhole = false;
+			for (size_t i = 0; i < handlers.size(); ++i)
+			{
+				if (match(handlers[i].patternLevels, topicLevels))
+				{
+					used = true;
+					if (handlers[i].chunkHandler)
+					{
+						chunkTargets.push_back(i);
+					}
+					else
+					{
+						needsWhole = true;
+					}
+				}
+			}
+
+			account(topicLevels, used);
+
+			if (!chunkTargets.empty())
+			{
+				++largeStats.streamed;
+			}
+			if (needsWhole && total > LargePayloadPool)
+			{
+				needsWhole = false;
+				++largeStats.dropped;
+			}
+			if (needsWhole)
+			{
+				pool.reserve(LargePayloadPool);
+				pool.clear();
+			}
+		}
+
+		for (size_t i : chunkTargets)
+		{
+			ALLOC_SCOPE(Handler);
+			handlers[i].chunkHandler(topic, data, length, offset, total);
+		}
+
+		if (needsWhole)
+		{
+			pool.append((const char*)data, length);
+			if (offset + length == total)
+			{
+				++largeStats.pooled;
+				dispatchWhole(topic, levelsOf(topic), pool, false);
+			}
+		}
+	}
+
+	const LargeMessageStats& largeMessageStats() const
+	{
+		return largeStats;
+	}
+
+	void dispatch(const std::string& topic, const std::string& payload)
+	{
+		TRACE_SCOPE(Dispatch);
+		ALLOC_SCOPE(Dispatch);
+		const TopicLevels topicLevels = levelsOf(topic);
+		account(topicLevels, dispatchWhole(topic, topicLevels, payload, true));
+	}
+
+	// Where the levels of a topic start and end, found without copying or allocating
+	// (include/TopicTokenizer.h), so matching a message costs nothing on the heap
+	using TopicLevels = TopicTokenizer::Levels;
+
+	static TopicLevels levelsOf(const std::string& topic)
+	{
+		return TopicTokenizer::tokenize(topic);
 	}
 
 private:
-	std::vector<std::pair<std::vector<std::string>, Handler>> handlers;
+	// Returns whether any matching handler used the message
+	bool dispatchWhole(const std::string& topic, const TopicLevels& topicLevels, const std::string& payload, bool includeChunkHandlers)
+	{
+		ParsedPayload parsed;
+		bool isParsed = false;
+		uint32_t matched = 0;
+		ignoredInDispatch = 0;
+
+		for (size_t i = 0; i < handlers.size(); ++i)
+		{
+			const auto& [patternLevels, handler, valueHandler, chunkHandler] = handlers[i];
+			if (!match(patternLevels, topicLevels))
+			{
+				continue;
+			}
+			++matched;
+			TRACE_SCOPE_ARG(Handler, i);
+			ALLOC_SCOPE(Handler);
+
+			if (handler)
+			{
+				handler(topic, payload);
+			}
+			else if (chunkHandler)
+			{
+				if (includeChunkHandlers)
+				{
+					chunkHandler(topic, (const uint8_t*)payload.data(), payload.size(), 0, payload.size());
+				}
+			}
+			else
+			{
+				if (!isParsed)
+				{
+					parsed = parsePayload(payload.data(), payload.size());
+					isParsed = true;
+				}
+				valueHandler(topic, parsed);
+			}
+		}
+
+		return matched > ignoredInDispatch;
+	}
+
+	void account(const TopicLevels& topicLevels, bool used)
+	{
+		for (size_t i = 0; i < filterLevels.size(); ++i)
+		{
+			if (match(filterLevels[i], topicLevels))
+			{
+				++filters[i].received;
+				filters[i].used += used ? 1 : 0;
+			}
+		}
+	}
+
+	struct Registration
+	{
+		std::vector<std::string> patternLevels;
+		Handler handler;
+		ValueHandler valueHandler;
+		ChunkHandler chunkHandler;
+	};
+
+	// Registration happens at boot; sizing chunkTargets here keeps dispatch off the heap
+	void add(Registration&& registration)
+	{
+		handlers.push_back(std::move(registration));
+		chunkTargets.reserve(handlers.size());
+		filtersStale = true;
+	}
+
+	std::vector<Registration> handlers;
+	std::vector<size_t> chunkTargets;
+	std::string pool;
+	bool needsWhole = false;
+	LargeMessageStats largeStats = {};
+	std::vector<SubscriptionStats> filters;
+	std::vector<std::vector<std::string>> filterLevels;
+	bool filtersStale = true;
+	uint32_t ignoredInDispatch = 0;
 
 	static std::vector<std::string> split(const std::string& topic)
 	{
+		const TopicLevels levels = levelsOf(topic);
 		std::vector<std::string> result;
-		std::stringstream ss(topic);
-		std::string item;
-		while (std::getline(ss, item, '/'))
+		for (size_t i = 0; i < levels.count; ++i)
 		{
-			result.push_back(item);
+			result.emplace_back(topic, levels.start[i], levels.length[i]);
 		}
 		return result;
 	}
 
-	static bool match(const std::vector<std::string>& pattern, const std::vector<std::string>& topic)
+	static std::string join(const std::vector<std::string>& levels)
 	{
-		size_t i = 0;
-		for (; i < pattern.size(); ++i)
+		std::string result;
+		for (size_t i = 0; i < levels.size(); ++i)
 		{
-			if (i >= topic.size())
+			result += i ? "/" : "";
+			result += levels[i];
+		}
+		return result;
+	}
+
+	// True when every topic matched by `narrow` is also matched by `wide`
+	static bool covers(const std::vector<std::string>& wide, const std::vector<std::string>& narrow)
+	{
+		for (size_t i = 0; i < wide.size(); ++i)
+		{
+			if (wide[i] == "#")
+			{
+				return true;
+			}
+			if (i >= narrow.size() || narrow[i] == "#")
+			{
+				return false;
+			}
+			if (wide[i] == "+")
+			{
+				continue;
+			}
+			if (narrow[i] == "+" || wide[i] != narrow[i])
 			{
-				return pattern[i] == "#";
+				return false;
 			}
+		}
+		return wide.size() == narrow.size();
+	}
 
+	static bool match(const std::vector<std::string>& pattern, const TopicLevels& topic)
+	{
+		size_t i = 0;
+		for (; i < pattern.size(); ++i)
+		{
 			if (pattern[i] == "#")
 			{
 				return true;
 			}
+			if (i >= topic.count)
+			{
+				return false;
+			}
 			if (pattern[i] == "+")
 			{
 				continue;
 			}
-			if (pattern[i] != topic[i])
+			if (!topic.equals(i, pattern[i]))
 			{
 				return false;
 			}
 		}
 
-		return i == topic.size();
+		return i == topic.count && !topic.truncated;
 	}
 };
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <ArduinoJson.h>
+
+// One reading of the device's memory health
+struct MemorySample
+{
+	uint32_t freeHeap;
+	uint32_t largestBlock;   // Largest single allocation that would still succeed
+	uint32_t minFreeHeap;    // Lowest free heap since boot
+	uint32_t lvglFree;       // LVGL's own pool; 0 when LVGL allocates from the heap
+	uint32_t lvglLargest;
+	uint8_t lvglFragmentation;
+	int32_t minStackFree;    // Smallest task stack high-water mark in bytes, -1 when unknown
+	const char* minStackTask;
+};
+
+struct MemoryLimits
+{
+	uint32_t minFreeHeap = 10240;
+	uint32_t minLargestBlock = 4096;
+	uint8_t maxFragmentation = 85;  // Percent of free heap not in the largest block
+	int32_t minStackFree = 512;
+	uint8_t strikes = 3;            // Consecutive bad samples before a restart
+};
+
+// Decides when memory has degraded far enough that a planned restart beats
+// waiting for an allocation to fail somewhere inside WiFi, TLS or LVGL. A
+// breached limit is reported at once; the restart only comes after it has
+// held for several samples in a row, so a transient dip (a TLS handshake, a
+// large discovery message) does not reboot the device.
+class MemoryMonitor
+{
+public:
+	enum Verdict : uint8_t
+	{
+		Healthy,
+		Warning, // A limit is breached, not yet for long enough
+		Restart,
+	};
+
+	// {"min_free_heap":10240,"min_largest_block":4096,"max_fragmentation":85,"min_stack":512,"strikes":3};
+	// missing keys keep their defaults
+	bool configure(const std::string& json)
+	{
+		JsonDocument doc;
+		if (deserializeJson(doc, json))
+		{
+			return false;
+		}
+
+		const MemoryLimits defaults;
+		limits.minFreeHeap = doc["min_free_heap"] | defaults.minFreeHeap;
+		limits.minLargestBlock = doc["min_largest_block"] | defaults.minLargestBlock;
+		limits.maxFragmentation = doc["max_fragmentation"] | defaults.maxFragmentation;
+		limits.minStackFree = doc["min_stack"] | defaults.minStackFree;
+		limits.strikes = doc["strikes"] | defaults.strikes;
+		limits.strikes = limits.strikes ? limits.strikes : 1;
+		return true;
+	}
+
+	Verdict check(const MemorySample& sample)
+	{
+		last = sample;
+		reasonText[0] = '\0';
+		if (sample.freeHeap < limits.minFreeHeap)
+		{
+			snprintf(reasonText, sizeof(reasonText), "free heap %u < %u", (unsigned)sample.freeHeap, (unsigned)limits.minFreeHeap);
+		}
+		else if (sample.largestBlock < limits.minLargestBlock)
+		{
+			snprintf(reasonText, sizeof(reasonText), "largest block %u < %u", (unsigned)sample.largestBlock, (unsigned)limits.minLargestBlock);
+		}
+		else if (limits.maxFragmentation && fragmentation(sample) > limits.maxFragmentation)
+		{
+			snprintf(reasonText, sizeof(reasonText), "fragmentation %u%% > %u%%", (unsigned)fragmentation(sample), (unsigned)limits.maxFragmentation);
+		}
+		else if (sample.minStackFree >= 0 && sample.minStackFree < limits.minStackFree)
+		{
+			snprintf(reasonText, sizeof(reasonText), "%s stack %d < %d", sample.minStackTask ? sample.minStackTask : "task",
+			         (int)sample.minStackFree, (int)limits.minStackFree);
+		}
+
+		if (reasonText[0] == '\0')
+		{
+			strikes = 0;
+			return Healthy;
+		}
+		++warnings;
+		return ++strikes >= limits.strikes ? Restart : Warning;
+	}
+
+	static uint8_t fragmentation(const MemorySample& sample)
+	{
+		return sample.largestBlock < sample.freeHeap ? (uint8_t)(100 - (uint64_t)sample.largestBlock * 100 / sample.freeHeap) : 0;
+	}
+
+	const MemorySample& lastSample() const { return last; }
+	const MemoryLimits& currentLimits() const { return limits; }
+	const char* reason() const { return reasonText; } // Of the last breach
+	uint32_t warningCount() const { return warnings; }
+
+private:
+	MemoryLimits limits;
+	MemorySample last = {};
+	uint8_t strikes = 0;
+	uint32_t warnings = 0;
+	char reasonText[48] = "";
+};
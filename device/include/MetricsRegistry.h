@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <functional>
+#include <ArduinoJson.h>
+
+using MetricSampler = std::function<float()>;
+using MetricPublisher = std::function<bool(const char* topic, const char* payload, bool retained)>;
+
+// Device health metrics, exposed to Home Assistant through MQTT discovery.
+// Discovery payloads are built once and cached, so reconnects only replay
+// them, a few per loop() pass so the UI keeps refreshing while they go out.
+// States go out the same way, as there are more metrics than PublishQueue holds.
+class MetricsRegistry
+{
+public:
+	void begin(const std::string& id, const std::string& name)
+	{
+		deviceId = id;
+		deviceName = name;
+		discoveryBuilt = false;
+	}
+
+	void registerMetric(const std::string& name, const std::string& unit, const std::string& deviceClass, const MetricSampler sampler)
+	{
+		metrics.push_back({name, unit, deviceClass, sampler, "", "", ""});
+		discoveryBuilt = false;
+	}
+
+	// Call on every (re)connect; restarts the retained discovery replay.
+	void beginDiscovery()
+	{
+		if (!discoveryBuilt)
+		{
+			buildDiscovery();
+		}
+		discoveryCursor = 0;
+	}
+
+	// Publishes up to batchSize pending discovery messages; returns true once all are out.
+	bool publishDiscovery(const MetricPublisher& publish, size_t batchSize)
+	{
+		size_t sent = 0;
+		while (discoveryCursor < metrics.size() && sent < batchSize)
+		{
+			const auto& metric = metrics[discoveryCursor];
+			if (!publish(metric.configTopic.c_str(), metric.configPayload.c_str(), true))
+			{
+				return false; // Retry the same message on the next pass
+			}
+			++discoveryCursor;
+			++sent;
+		}
+
+		return discoveryCursor >= metrics.size();
+	}
+
+	// Call once per reporting period; restarts the state round.
+	void beginStates()
+	{
+		stateCursor = 0;
+	}
+
+	// Samples and publishes up to batchSize pending states; returns true once all are out.
+	bool publishStates(const MetricPublisher& publish, size_t batchSize)
+	{
+		char value[24];
+		size_t sent = 0;
+		while (stateCursor < metrics.size() && sent < batchSize)
+		{
+			const auto& metric = metrics[stateCursor];
+			snprintf(value, sizeof(value), "%.2f", metric.sampler());
+			if (!publish(metric.stateTopic.c_str(), value, false))
+			{
+				return false; // Sampled again on the next pass
+			}
+			++stateCursor;
+			++sent;
+		}
+
+		return stateCursor >= metrics.size();
+	}
+
+	bool discoveryPending() const
+	{
+		return !discoveryBuilt || discoveryCursor < metrics.size();
+	}
+
+private:
+	struct Metric
+	{
+		std::string name;
+		std::string unit;
+		std::string deviceClass;
+		MetricSampler sampler;
+		std::string stateTopic;
+		std::string configTopic;
+		std::string configPayload;
+	};
+
+	std::vector<Metric> metrics;
+	std::string deviceId;
+	std::string deviceName;
+	bool discoveryBuilt = false;
+	size_t discoveryCursor = 0;
+	size_t stateCursor = SIZE_MAX; // Nothing pending until the first beginStates()
+
+	void buildDiscovery()
+	{
+		for (auto& metric : metrics)
+		{
+			metric.stateTopic = "cyd/" + deviceId + "/" + metric.name + "/state";
+			metric.configTopic = "homeassistant/sensor/" + deviceId + "/" + metric.name + "/config";
+
+			JsonDocument doc;
+			doc["name"] = metric.name;
+			doc["unique_id"] = deviceId + "_" + metric.name;
+			doc["state_topic"] = metric.stateTopic;
+			doc["state_class"] = "measurement";
+			if (!metric.unit.empty())
+			{
+				doc["unit_of_measurement"] = metric.unit;
+			}
+			if (!metric.deviceClass.empty())
+			{
+				doc["device_class"] = metric.deviceClass;
+			}
+
+			JsonObject device = doc["device"].to<JsonObject>();
+			device["identifiers"].add(deviceId);
+			device["name"] = deviceName;
+			device["model"] = "ESP32-2432S028R";
+
+			metric.configPayload.clear();
+			serializeJson(doc, metric.configPayload);
+		}
+
+		discoveryBuilt = true;
+	}
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compact recording of broker traffic for replaying on the host
+// (utils/bench/mqtt_capture.cpp writes one, native/src/replay_native.cpp plays it).
+//
+// File: "CYDCAP" 0x01 0x00, then one record per message:
+//   varint  microseconds since the previous record
+//   varint  topic id << 1 | retained; an id one past the last seen introduces a
+//           new topic and is followed by varint length + topic bytes
+//   varint  payload length, payload bytes
+// Topics repeat all the time in HA traffic, so most records are a few bytes of
+// framing plus the payload.
+namespace MqttCapture
+{
+	static const char Magic[] = "CYDCAP";
+	static const uint8_t Version = 1;
+
+	struct Message
+	{
+		uint64_t timeUs;          // Since the first record
+		const std::string* topic; // Owned by the Reader
+		const uint8_t* payload;
+		size_t length;
+		bool retained;
+	};
+
+	inline void appendVarint(std::vector<uint8_t>& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((uint8_t)value);
+	}
+
+	class Writer
+	{
+	public:
+		Writer() : bytes(Magic, Magic + 6)
+		{
+			bytes.push_back(Version);
+			bytes.push_back(0);
+		}
+
+		void add(uint64_t timeUs, const std::string& topic, const uint8_t* payload, size_t length, bool retained)
+		{
+			appendVarint(bytes, timeUs >= lastUs ? timeUs - lastUs : 0);
+			lastUs = timeUs > lastUs ? timeUs : lastUs;
+
+			auto known = topicIds.find(topic);
+			if (known != topicIds.end())
+			{
+				appendVarint(bytes, (uint64_t)known->second << 1 | (retained ? 1 : 0));
+			}
+			else
+			{
+				const uint32_t id = (uint32_t)topicIds.size();
+				topicIds.emplace(topic, id);
+				appendVarint(bytes, (uint64_t)id << 1 | (retained ? 1 : 0));
+				appendVarint(bytes, topic.size());
+				bytes.insert(bytes.end(), topic.begin(), topic.end());
+			}
+
+			appendVarint(bytes, length);
+			bytes.insert(bytes.end(), payload, payload + length);
+			++count;
+		}
+
+		bool save(const char* path) const
+		{
+			FILE* file = fopen(path, "wb");
+			if (!file)
+			{
+				return false;
+			}
+			const bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+			return fclose(file) == 0 && written;
+		}
+
+		const std::vector<uint8_t>& data() const { return bytes; }
+		size_t messages() const { return count; }
+		size_t topics() const { return topicIds.size(); }
+
+	private:
+		std::vector<uint8_t> bytes;
+		std::unordered_map<std::string, uint32_t> topicIds;
+		uint64_t lastUs = 0;
+		size_t count = 0;
+	};
+
+	// Walks a capture held in memory; payloads point into it
+	class Reader
+	{
+	public:
+		bool load(const char* path)
+		{
+			FILE* file = fopen(path, "rb");
+			if (!file)
+			{
+				return false;
+			}
+			bytes.clear();
+			uint8_t buffer[4096];
+			size_t n;
+			while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			{
+				bytes.insert(bytes.end(), buffer, buffer + n);
+			}
+			fclose(file);
+			return open(std::move(bytes));
+		}
+
+		bool open(std::vector<uint8_t> data)
+		{
+			bytes = std::move(data);
+			topics.clear();
+			rewind();
+			return bytes.size() >= 8 && std::equal(Magic, Magic + 6, bytes.begin()) && bytes[6] == Version;
+		}
+
+		// Starts over; topics already seen are not copied again
+		void rewind()
+		{
+			offset = 8;
+			timeUs = 0;
+			introduced = 0;
+		}
+
+		// False at the end of the capture or on a truncated record
+		bool next(Message& out)
+		{
+			uint64_t delta, reference, length;
+			if (!readVarint(delta) || !readVarint(reference))
+			{
+				return false;
+			}
+
+			const size_t id = (size_t)(reference >> 1);
+			if (id == introduced)
+			{
+				if (!readVarint(length) || length > bytes.size() - offset)
+				{
+					return false;
+				}
+				if (id == topics.size())
+				{
+					topics.emplace_back((const char*)bytes.data() + offset, (size_t)length);
+				}
+				offset += (size_t)length;
+				++introduced;
+			}
+			else if (id > introduced)
+			{
+				return false;
+			}
+
+			if (!readVarint(length) || length > bytes.size() - offset)
+			{
+				return false;
+			}
+			timeUs += delta;
+			out.timeUs = timeUs;
+			out.topic = &topics[id];
+			out.payload = bytes.data() + offset;
+			out.length = (size_t)length;
+			out.retained = reference & 1;
+			offset += (size_t)length;
+			return true;
+		}
+
+		size_t size() const { return bytes.size(); }
+		size_t topicCount() const { return topics.size(); }
+
+	private:
+		std::vector<uint8_t> bytes;
+		std::deque<std::string> topics; // Indexed by topic id; a deque so Message::topic stays valid
+		size_t introduced = 0;          // Topics defined so far in this pass
+		size_t offset = 8;
+		uint64_t timeUs = 0;
+
+		bool readVarint(uint64_t& value)
+		{
+			value = 0;
+			for (unsigned shift = 0; offset < bytes.size() && shift < 64; shift += 7)
+			{
+				const uint8_t b = bytes[offset++];
+				value |= (uint64_t)(b & 0x7F) << shift;
+				if (!(b & 0x80))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+}
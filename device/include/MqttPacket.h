@@ -0,0 +1,296 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// MQTT 3.1.1 packet encoding and decoding for the pieces PubSubClient does not
+// cover: multi-filter SUBSCRIBE on the device, and the host tools and fake
+// broker that talk MQTT without PubSubClient.
+namespace MqttPacket
+{
+	enum Type : uint8_t
+	{
+		Connect = 1,
+		Connack = 2,
+		Publish = 3,
+		Puback = 4,
+		Subscribe = 8,
+		Suback = 9,
+		Pingreq = 12,
+		Pingresp = 13,
+		Disconnect = 14,
+	};
+
+	inline void appendRemainingLength(std::vector<uint8_t>& out, size_t length)
+	{
+		do
+		{
+			uint8_t b = length % 128;
+			length /= 128;
+			out.push_back(length > 0 ? (b | 0x80) : b);
+		} while (length > 0);
+	}
+
+	inline void appendString(std::vector<uint8_t>& out, const std::string& value)
+	{
+		out.push_back((uint8_t)(value.size() >> 8));
+		out.push_back((uint8_t)value.size());
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	inline std::vector<uint8_t> packet(uint8_t header, const std::vector<uint8_t>& body)
+	{
+		std::vector<uint8_t> out;
+		out.reserve(body.size() + 5);
+		out.push_back(header);
+		appendRemainingLength(out, body.size());
+		out.insert(out.end(), body.begin(), body.end());
+		return out;
+	}
+
+	// One SUBSCRIBE carrying every filter, so the broker answers with a single SUBACK;
+	// qos holds one entry per filter
+	inline std::vector<uint8_t> subscribe(uint16_t packetId, const std::vector<std::string>& filters, const std::vector<uint8_t>& qos)
+	{
+		size_t body = 2;
+		for (const auto& filter : filters)
+		{
+			body += 2 + filter.size() + 1;
+		}
+
+		std::vector<uint8_t> out;
+		out.reserve(body + 5);
+		out.push_back(0x82);
+		appendRemainingLength(out, body);
+		out.push_back((uint8_t)(packetId >> 8));
+		out.push_back((uint8_t)packetId);
+		for (size_t i = 0; i < filters.size(); ++i)
+		{
+			appendString(out, filters[i]);
+			out.push_back(qos[i]);
+		}
+		return out;
+	}
+
+	inline std::vector<uint8_t> subscribe(uint16_t packetId, const std::vector<std::string>& filters, uint8_t qos)
+	{
+		return subscribe(packetId, filters, std::vector<uint8_t>(filters.size(), qos));
+	}
+
+	inline std::vector<uint8_t> connect(const std::string& clientId, const std::string& user, const std::string& password,
+	                                    uint16_t keepAlive, bool cleanSession)
+	{
+		std::vector<uint8_t> body;
+		appendString(body, "MQTT");
+		body.push_back(4); // Protocol level 3.1.1
+		body.push_back((uint8_t)((cleanSession ? 0x02 : 0) | (user.empty() ? 0 : 0x80) | (password.empty() ? 0 : 0x40)));
+		body.push_back((uint8_t)(keepAlive >> 8));
+		body.push_back((uint8_t)keepAlive);
+		appendString(body, clientId);
+		if (!user.empty())
+		{
+			appendString(body, user);
+		}
+		if (!password.empty())
+		{
+			appendString(body, password);
+		}
+		return packet(Connect << 4, body);
+	}
+
+	inline std::vector<uint8_t> connack(bool sessionPresent, uint8_t returnCode)
+	{
+		return packet(Connack << 4, {(uint8_t)(sessionPresent ? 1 : 0), returnCode});
+	}
+
+	inline std::vector<uint8_t> publish(const std::string& topic, const uint8_t* payload, size_t length,
+	                                    uint8_t qos, bool retained, uint16_t packetId)
+	{
+		std::vector<uint8_t> body;
+		body.reserve(2 + topic.size() + 2 + length);
+		appendString(body, topic);
+		if (qos > 0)
+		{
+			body.push_back((uint8_t)(packetId >> 8));
+			body.push_back((uint8_t)packetId);
+		}
+		body.insert(body.end(), payload, payload + length);
+		return packet((uint8_t)((Publish << 4) | (qos << 1) | (retained ? 1 : 0)), body);
+	}
+
+	inline std::vector<uint8_t> suback(uint16_t packetId, size_t filterCount, uint8_t qos)
+	{
+		std::vector<uint8_t> body = {(uint8_t)(packetId >> 8), (uint8_t)packetId};
+		body.insert(body.end(), filterCount, qos);
+		return packet(Suback << 4, body);
+	}
+
+	inline std::vector<uint8_t> suback(uint16_t packetId, const std::vector<uint8_t>& granted)
+	{
+		std::vector<uint8_t> body = {(uint8_t)(packetId >> 8), (uint8_t)packetId};
+		body.insert(body.end(), granted.begin(), granted.end());
+		return packet(Suback << 4, body);
+	}
+
+	inline std::vector<uint8_t> puback(uint16_t packetId)
+	{
+		return packet(Puback << 4, {(uint8_t)(packetId >> 8), (uint8_t)packetId});
+	}
+
+	// Reassembles packets from a byte stream fed in pieces of any size.
+	class Reader
+	{
+	public:
+		// Consumes bytes up to the end of the next complete packet; returns how many were used.
+		// complete() is true afterwards when a packet is ready.
+		size_t feed(const uint8_t* data, size_t length)
+		{
+			if (ready)
+			{
+				reset();
+			}
+
+			size_t used = 0;
+			while (used < length && !ready)
+			{
+				const uint8_t b = data[used++];
+				if (!haveHeader)
+				{
+					header = b;
+					haveHeader = true;
+					remaining = 0;
+					multiplier = 1;
+					continue;
+				}
+				if (!haveLength)
+				{
+					remaining += (b & 0x7F) * multiplier;
+					multiplier *= 128;
+					if (!(b & 0x80))
+					{
+						haveLength = true;
+						bodyBytes.reserve(remaining);
+						ready = remaining == 0;
+					}
+					continue;
+				}
+				bodyBytes.push_back(b);
+				ready = bodyBytes.size() == remaining;
+			}
+			return used;
+		}
+
+		bool complete() const { return ready; }
+		Type type() const { return (Type)(header >> 4); }
+		uint8_t flags() const { return header & 0x0F; }
+		const std::vector<uint8_t>& body() const { return bodyBytes; }
+
+		void reset()
+		{
+			haveHeader = haveLength = ready = false;
+			bodyBytes.clear();
+		}
+
+	private:
+		uint8_t header = 0;
+		size_t remaining = 0;
+		size_t multiplier = 1;
+		bool haveHeader = false;
+		bool haveLength = false;
+		bool ready = false;
+		std::vector<uint8_t> bodyBytes;
+	};
+
+	struct PublishView
+	{
+		std::string topic;
+		const uint8_t* payload;
+		size_t length;
+		uint16_t packetId;
+		uint8_t qos;
+		bool retained;
+	};
+
+	inline bool parsePublish(const Reader& reader, PublishView& out)
+	{
+		const std::vector<uint8_t>& body = reader.body();
+		if (reader.type() != Publish || body.size() < 2)
+		{
+			return false;
+		}
+		const size_t topicLength = (size_t)(body[0] << 8 | body[1]);
+		out.qos = (reader.flags() >> 1) & 0x03;
+		out.retained = reader.flags() & 0x01;
+		size_t offset = 2 + topicLength + (out.qos ? 2 : 0);
+		if (offset > body.size())
+		{
+			return false;
+		}
+		out.topic.assign((const char*)body.data() + 2, topicLength);
+		out.packetId = out.qos ? (uint16_t)(body[2 + topicLength] << 8 | body[3 + topicLength]) : 0;
+		out.payload = body.data() + offset;
+		out.length = body.size() - offset;
+		return true;
+	}
+
+	inline uint16_t packetIdOf(const Reader& reader)
+	{
+		const std::vector<uint8_t>& body = reader.body();
+		return body.size() >= 2 ? (uint16_t)(body[0] << 8 | body[1]) : 0;
+	}
+
+	// Topic filters of a SUBSCRIBE packet, and the QoS requested for each when asked
+	inline std::vector<std::string> subscribeFilters(const Reader& reader, std::vector<uint8_t>* qos = nullptr)
+	{
+		std::vector<std::string> filters;
+		const std::vector<uint8_t>& body = reader.body();
+		size_t offset = 2;
+		while (offset + 2 <= body.size())
+		{
+			const size_t length = (size_t)(body[offset] << 8 | body[offset + 1]);
+			if (offset + 2 + length + 1 > body.size())
+			{
+				break;
+			}
+			filters.emplace_back((const char*)body.data() + offset + 2, length);
+			if (qos)
+			{
+				qos->push_back(body[offset + 2 + length]);
+			}
+			offset += 2 + length + 1;
+		}
+		return filters;
+	}
+
+	// Topic filter match with MQTT wildcard rules ('#' also matches the parent level)
+	inline bool topicMatches(const char* filter, const char* topic)
+	{
+		while (*filter)
+		{
+			if (*filter == '#')
+			{
+				return true;
+			}
+			if (*filter == '+')
+			{
+				while (*topic && *topic != '/')
+				{
+					++topic;
+				}
+				++filter;
+			}
+			else
+			{
+				if (*filter != *topic)
+				{
+					// "a/#" matches "a"
+					return *topic == '\0' && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0';
+				}
+				++filter;
+				++topic;
+			}
+		}
+		return *topic == '\0';
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+struct ParsedPayload
+{
+	enum Kind : uint8_t
+	{
+		Number,
+		Unavailable, // Home Assistant "unavailable"
+		Unknown,     // Home Assistant "unknown"
+		Text,        // Anything else, handlers get the raw string only
+	};
+
+	Kind kind = Text;
+	bool isInteger = false;
+	int64_t integer = 0;
+	double value = 0.0;
+};
+
+// Locale-free numeric parse in the spirit of std::from_chars (whose floating
+// point overload the ESP32 toolchain lacks). Accepts optional surrounding
+// whitespace, sign, fraction and exponent; no hex, inf or nan.
+inline ParsedPayload parsePayload(const char* data, size_t length)
+{
+	ParsedPayload result;
+
+	const char* p = data;
+	const char* end = data + length;
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+	{
+		++p;
+	}
+	while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+	{
+		--end;
+	}
+
+	const size_t trimmed = end - p;
+	if (trimmed == 11 && memcmp(p, "unavailable", 11) == 0)
+	{
+		result.kind = ParsedPayload::Unavailable;
+		return result;
+	}
+	if (trimmed == 7 && memcmp(p, "unknown", 7) == 0)
+	{
+		result.kind = ParsedPayload::Unknown;
+		return result;
+	}
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	// Up to 19 significant digits go into the mantissa; the rest only shift the exponent
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool sawDigit = false;
+	bool sawPoint = false;
+	bool overflow = false;
+
+	for (; p < end; ++p)
+	{
+		const unsigned digit = (unsigned)(*p - '0');
+		if (digit < 10)
+		{
+			sawDigit = true;
+			if (digits < 19)
+			{
+				if (mantissa != 0 || digit != 0)
+				{
+					++digits;
+				}
+				mantissa = mantissa * 10 + digit;
+				if (sawPoint)
+				{
+					--exponent;
+				}
+			}
+			else
+			{
+				overflow = true;
+				if (!sawPoint)
+				{
+					++exponent;
+				}
+			}
+		}
+		else if (*p == '.' && !sawPoint)
+		{
+			sawPoint = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (!sawDigit)
+	{
+		return result;
+	}
+
+	bool sawExponent = false;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExponent = *p == '-';
+			++p;
+		}
+		int explicitExponent = 0;
+		const char* exponentStart = p;
+		for (; p < end && (unsigned)(*p - '0') < 10; ++p)
+		{
+			if (explicitExponent < 10000)
+			{
+				explicitExponent = explicitExponent * 10 + (*p - '0');
+			}
+		}
+		if (p == exponentStart)
+		{
+			return result;
+		}
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+		sawExponent = true;
+	}
+
+	if (p != end)
+	{
+		return result; // Trailing garbage, e.g. "21.5 C" or a JSON document
+	}
+
+	static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+	double value = (double)mantissa;
+	int remaining = exponent;
+	while (remaining > 22)
+	{
+		value *= 1e22;
+		remaining -= 22;
+	}
+	while (remaining < -22)
+	{
+		value /= 1e22;
+		remaining += 22;
+	}
+	value = remaining >= 0 ? value * powers[remaining] : value / powers[-remaining];
+
+	result.kind = ParsedPayload::Number;
+	result.value = negative ? -value : value;
+	if (!sawPoint && !sawExponent && !overflow && mantissa <= (uint64_t)INT64_MAX)
+	{
+		result.isInteger = true;
+		result.integer = negative ? -(int64_t)mantissa : (int64_t)mantissa;
+	}
+	return result;
+}
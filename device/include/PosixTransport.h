@@ -0,0 +1,148 @@
+#pragma once
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include "Transport.h"
+
+// TCP transport over POSIX sockets, for running the MQTT path on a Linux host
+// against a real broker. The socket is non-blocking once connected.
+class PosixTransport : public Transport
+{
+public:
+	// How long send() waits for a full socket buffer to drain before giving up on the peer
+	static constexpr int SendTimeoutMs = 5000;
+
+	~PosixTransport() override
+	{
+		close();
+	}
+
+	bool open(const char* host, uint16_t port) override
+	{
+		close();
+
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* addresses = nullptr;
+		char service[8];
+		snprintf(service, sizeof(service), "%u", port);
+		if (getaddrinfo(host, service, &hints, &addresses) != 0)
+		{
+			return false;
+		}
+
+		for (addrinfo* address = addresses; address && fd < 0; address = address->ai_next)
+		{
+			fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) != 0)
+			{
+				::close(fd);
+				fd = -1;
+			}
+		}
+		freeaddrinfo(addresses);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		// Small MQTT packets must not wait for Nagle
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		return true;
+	}
+
+	void close() override
+	{
+		if (fd >= 0)
+		{
+			::close(fd);
+			fd = -1;
+		}
+	}
+
+	bool isOpen() override
+	{
+		return fd >= 0;
+	}
+
+	size_t send(const uint8_t* data, size_t length) override
+	{
+		size_t sent = 0;
+		while (fd >= 0 && sent < length)
+		{
+			ssize_t n = ::send(fd, data + sent, length - sent, MSG_NOSIGNAL);
+			if (n > 0)
+			{
+				sent += n;
+			}
+			else if (n < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				// Socket buffer full. Packets must go out whole, so wait for room, but not for
+				// a broker that has stopped reading
+				pollfd writable = {fd, POLLOUT, 0};
+				if (poll(&writable, 1, SendTimeoutMs) <= 0)
+				{
+					close();
+				}
+			}
+			else
+			{
+				close();
+			}
+		}
+		return sent;
+	}
+
+	int receive(uint8_t* data, size_t length) override
+	{
+		if (fd < 0)
+		{
+			return -1;
+		}
+		ssize_t n = ::recv(fd, data, length, 0);
+		if (n > 0)
+		{
+			return (int)n;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		{
+			return 0;
+		}
+		close();
+		return -1;
+	}
+
+	size_t pending() override
+	{
+		int available = 0;
+		if (fd < 0 || ioctl(fd, FIONREAD, &available) != 0)
+		{
+			return 0;
+		}
+		return (size_t)available;
+	}
+
+	// For poll()/select() in host tools
+	int descriptor() const
+	{
+		return fd;
+	}
+
+private:
+	int fd = -1;
+};
@@ -0,0 +1,213 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+using QueuePublisher = std::function<bool(const char* topic, const uint8_t* payload, size_t length, bool retained)>;
+
+// Bounded outbound MQTT queue. Messages wait here while the client is
+// disconnected and go out a few per loop() pass once it is connected. A
+// message for a topic that is still queued replaces the queued payload rather
+// than taking another slot. When full, the oldest message of the least
+// important class makes room, and every drop is counted. Pinned messages are
+// never evicted: their sender has moved on and would not queue them again.
+class PublishQueue
+{
+public:
+	enum Priority : uint8_t
+	{
+		Critical, // Alerts
+		Normal,   // Metrics and state
+		Bulk,     // Discovery configs and other replayable traffic
+		PriorityCount,
+	};
+
+	static constexpr size_t Capacity = 24;
+	static constexpr size_t TopicSize = 96;
+	static constexpr size_t PayloadSize = 128;
+
+	struct Stats
+	{
+		uint32_t enqueued;
+		uint32_t published;
+		uint32_t coalesced;
+		uint32_t failed;
+		uint32_t dropped[PriorityCount];
+		uint16_t highWater;
+	};
+
+	bool enqueue(const char* topic, const uint8_t* payload, size_t length, bool retained, Priority priority)
+	{
+		if (length > PayloadSize)
+		{
+			++stats.dropped[priority];
+			return false;
+		}
+
+		Entry* entry = acquire(topic, priority, false);
+		if (!entry)
+		{
+			return false;
+		}
+		memcpy(entry->inlinePayload, payload, length);
+		entry->external = nullptr;
+		entry->length = (uint16_t)length;
+		entry->retained = retained;
+		return true;
+	}
+
+	bool enqueue(const char* topic, const char* payload, bool retained, Priority priority)
+	{
+		return enqueue(topic, (const uint8_t*)payload, strlen(payload), retained, priority);
+	}
+
+	// Queues a payload by reference; it must stay valid until published (e.g. cached discovery JSON).
+	bool enqueueStatic(const char* topic, const char* payload, bool retained, Priority priority, bool pinned = false)
+	{
+		Entry* entry = acquire(topic, priority, pinned);
+		if (!entry)
+		{
+			return false;
+		}
+		entry->external = payload;
+		entry->length = (uint16_t)strlen(payload);
+		entry->retained = retained;
+		return true;
+	}
+
+	// Sends up to maxMessages, most important and then oldest first. Stops at the
+	// first failure and keeps that message for the next attempt.
+	size_t flush(const QueuePublisher& publish, size_t maxMessages)
+	{
+		size_t sent = 0;
+		while (sent < maxMessages && count > 0)
+		{
+			Entry* next = nullptr;
+			for (auto& entry : entries)
+			{
+				if (entry.used && (!next || entry.priority < next->priority ||
+				                   (entry.priority == next->priority && entry.sequence < next->sequence)))
+				{
+					next = &entry;
+				}
+			}
+
+			const uint8_t* payload = next->external ? (const uint8_t*)next->external : next->inlinePayload;
+			if (!publish(next->topic, payload, next->length, next->retained))
+			{
+				++stats.failed;
+				break;
+			}
+
+			next->used = false;
+			next->pinned = false;
+			--count;
+			++stats.published;
+			++sent;
+		}
+		return sent;
+	}
+
+	size_t depth() const
+	{
+		return count;
+	}
+
+	uint32_t droppedTotal() const
+	{
+		uint32_t total = 0;
+		for (uint32_t dropped : stats.dropped)
+		{
+			total += dropped;
+		}
+		return total;
+	}
+
+	const Stats& statistics() const
+	{
+		return stats;
+	}
+
+private:
+	struct Entry
+	{
+		char topic[TopicSize];
+		uint8_t inlinePayload[PayloadSize];
+		const char* external;
+		uint32_t sequence;
+		uint16_t length;
+		Priority priority;
+		bool retained;
+		bool pinned;
+		bool used;
+	};
+
+	std::array<Entry, Capacity> entries = {};
+	size_t count = 0;
+	uint32_t nextSequence = 0;
+	Stats stats = {};
+
+	// Returns the slot to fill for topic: the queued one to coalesce with, a free one, or an evicted one.
+	Entry* acquire(const char* topic, Priority priority, bool pinned)
+	{
+		if (strlen(topic) >= TopicSize)
+		{
+			++stats.dropped[priority];
+			return nullptr;
+		}
+		++stats.enqueued;
+
+		Entry* free = nullptr;
+		Entry* victim = nullptr;
+		for (auto& entry : entries)
+		{
+			if (!entry.used)
+			{
+				free = free ? free : &entry;
+				continue;
+			}
+			if (strcmp(entry.topic, topic) == 0)
+			{
+				// Coalesce: newest payload wins, the message keeps its place in line unless promoted
+				entry.priority = priority < entry.priority ? priority : entry.priority;
+				entry.pinned = entry.pinned || pinned;
+				++stats.coalesced;
+				return &entry;
+			}
+			if (entry.pinned)
+			{
+				continue;
+			}
+			if (!victim || entry.priority > victim->priority ||
+			    (entry.priority == victim->priority && entry.sequence < victim->sequence))
+			{
+				victim = &entry;
+			}
+		}
+
+		Entry* entry = free;
+		if (!entry)
+		{
+			if (!victim || victim->priority < priority)
+			{
+				++stats.dropped[priority];
+				return nullptr;
+			}
+			++stats.dropped[victim->priority];
+			entry = victim;
+		}
+		else
+		{
+			++count;
+			stats.highWater = count > stats.highWater ? (uint16_t)count : stats.highWater;
+		}
+
+		strcpy(entry->topic, topic);
+		entry->priority = priority;
+		entry->sequence = nextSequence++;
+		entry->pinned = pinned;
+		entry->used = true;
+		return entry;
+	}
+};
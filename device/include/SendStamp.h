@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Send timestamp carried at the front of a payload for latency measurement:
+// "t=<microseconds since the Unix epoch>;" followed by the real payload, e.g.
+// "t=1760000000123456;21.5". Written by utils/bench/mqtt_loadgen.cpp; the device
+// strips it in mqtt_callback() and mqtt_chunk_callback() and times the value to the
+// screen (LatencyTrace.h).
+namespace SendStamp
+{
+	inline void prepend(std::string& payload, uint64_t sentUs)
+	{
+		char prefix[32];
+		int n = snprintf(prefix, sizeof(prefix), "t=%llu;", (unsigned long long)sentUs);
+		payload.insert(0, prefix, (size_t)n);
+	}
+
+	// Length of the prefix (0 when the payload has none) and the time it carries
+	inline size_t parse(const char* payload, size_t length, uint64_t& sentUs)
+	{
+		if (length < 4 || payload[0] != 't' || payload[1] != '=')
+		{
+			return 0;
+		}
+		uint64_t value = 0;
+		for (size_t i = 2; i < length && i < 24; ++i)
+		{
+			const char c = payload[i];
+			if (c == ';')
+			{
+				sentUs = value;
+				return i > 2 ? i + 1 : 0;
+			}
+			if (c < '0' || c > '9')
+			{
+				return 0;
+			}
+			value = value * 10 + (uint64_t)(c - '0');
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,253 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+struct HistoryBucket
+{
+	float min;
+	float max;
+	float sum;
+	uint16_t count;
+
+	float average() const
+	{
+		return count ? sum / count : NAN;
+	}
+
+	void add(float value)
+	{
+		if (count == 0)
+		{
+			min = max = value;
+		}
+		else
+		{
+			min = value < min ? value : min;
+			max = value > max ? value : max;
+		}
+		sum += value;
+		++count;
+	}
+};
+
+// Fixed-capacity ring of closed buckets; index 0 is the oldest.
+template <size_t Capacity>
+class BucketRing
+{
+public:
+	void push(const HistoryBucket& bucket)
+	{
+		buckets[head] = bucket;
+		head = (head + 1) % Capacity;
+		if (count < Capacity)
+		{
+			++count;
+		}
+	}
+
+	void clear()
+	{
+		head = 0;
+		count = 0;
+	}
+
+	const HistoryBucket& operator[](size_t i) const
+	{
+		return buckets[(head + Capacity - count + i) % Capacity];
+	}
+
+	size_t size() const { return count; }
+	static constexpr size_t capacity() { return Capacity; }
+
+private:
+	std::array<HistoryBucket, Capacity> buckets = {};
+	size_t head = 0;
+	size_t count = 0;
+};
+
+// Seconds since boot for SensorHistory, counting on past the 49.7-day wrap of a
+// 32-bit millisecond clock. Call at least once per wrap period.
+class UptimeClock
+{
+public:
+	uint32_t seconds(uint32_t nowMs)
+	{
+		totalMs += (uint32_t)(nowMs - lastMs);
+		lastMs = nowMs;
+		return (uint32_t)(totalMs / 1000);
+	}
+
+private:
+	uint64_t totalMs = 0;
+	uint32_t lastMs = 0;
+};
+
+// Min/max/avg history at 1 min, 15 min and 1 h resolution. Memory is fixed at
+// construction: the defaults keep 24 h of minutes, 24 h of quarter hours and a
+// week of hours (~27 KB per sensor).
+template <size_t Minutes = 1440, size_t QuarterHours = 96, size_t Hours = 168>
+class SensorHistory
+{
+public:
+	enum Resolution : uint8_t
+	{
+		Minute,
+		QuarterHour,
+		Hour,
+	};
+
+	static constexpr size_t MinuteCapacity = Minutes;
+
+	// Bit set in the result of add()/advance() for each resolution that closed a bucket
+	static constexpr uint8_t closed(Resolution resolution) { return 1u << resolution; }
+
+	uint8_t add(float value, uint32_t seconds)
+	{
+		uint8_t mask = advance(seconds);
+		minutes.open.add(value);
+		quarterHours.open.add(value);
+		hours.open.add(value);
+		return mask;
+	}
+
+	// Closes buckets whose period has ended, padding gaps with empty buckets.
+	uint8_t advance(uint32_t seconds)
+	{
+		uint8_t mask = 0;
+		mask |= minutes.advance(seconds) ? closed(Minute) : 0;
+		mask |= quarterHours.advance(seconds) ? closed(QuarterHour) : 0;
+		mask |= hours.advance(seconds) ? closed(Hour) : 0;
+		return mask;
+	}
+
+	void clear()
+	{
+		minutes.clear();
+		quarterHours.clear();
+		hours.clear();
+	}
+
+	const BucketRing<Minutes>& minuteBuckets() const { return minutes.ring; }
+	const BucketRing<QuarterHours>& quarterHourBuckets() const { return quarterHours.ring; }
+	const BucketRing<Hours>& hourBuckets() const { return hours.ring; }
+
+private:
+	template <size_t Capacity, uint32_t Period>
+	struct Level
+	{
+		BucketRing<Capacity> ring;
+		HistoryBucket open = {};
+		uint32_t openIndex = UINT32_MAX;
+
+		void clear()
+		{
+			ring.clear();
+			open = {};
+			openIndex = UINT32_MAX;
+		}
+
+		bool advance(uint32_t seconds)
+		{
+			uint32_t index = seconds / Period;
+			if (openIndex == UINT32_MAX)
+			{
+				openIndex = index;
+				return false;
+			}
+			if (index < openIndex)
+			{
+				// The clock went backwards: nothing in the ring fits the new timeline
+				clear();
+				openIndex = index;
+				return true;
+			}
+			if (index == openIndex)
+			{
+				return false;
+			}
+
+			ring.push(open);
+			uint32_t gap = index - openIndex - 1;
+			if (gap >= Capacity)
+			{
+				ring.clear();
+			}
+			else
+			{
+				for (uint32_t i = 0; i < gap; ++i)
+				{
+					ring.push({});
+				}
+			}
+
+			open = {};
+			openIndex = index;
+			return true;
+		}
+	};
+
+	Level<Minutes, 60> minutes;
+	Level<QuarterHours, 15 * 60> quarterHours;
+	Level<Hours, 60 * 60> hours;
+};
+
+// Largest-Triangle-Three-Buckets: picks up to `threshold` of the `count` points
+// (x[i], y[i]) that best preserve the visual shape of the series, writing their
+// indices to `selected`. Returns the number of indices written.
+inline size_t lttb(const float* x, const float* y, size_t count, size_t threshold, uint16_t* selected)
+{
+	if (threshold >= count || threshold < 3)
+	{
+		size_t n = threshold < 3 && threshold < count ? threshold : count;
+		for (size_t i = 0; i < n; ++i)
+		{
+			selected[i] = (uint16_t)i;
+		}
+		return n;
+	}
+
+	const double every = (double)(count - 2) / (threshold - 2);
+	size_t a = 0;
+	size_t written = 0;
+	selected[written++] = 0;
+
+	for (size_t i = 0; i < threshold - 2; ++i)
+	{
+		// Average of the next bucket is the third triangle vertex
+		size_t nextStart = (size_t)((i + 1) * every) + 1;
+		size_t nextEnd = (size_t)((i + 2) * every) + 1;
+		nextEnd = nextEnd < count ? nextEnd : count;
+		double avgX = 0;
+		double avgY = 0;
+		for (size_t j = nextStart; j < nextEnd; ++j)
+		{
+			avgX += x[j];
+			avgY += y[j];
+		}
+		size_t nextCount = nextEnd > nextStart ? nextEnd - nextStart : 1;
+		avgX /= nextCount;
+		avgY /= nextCount;
+
+		size_t start = (size_t)(i * every) + 1;
+		size_t end = (size_t)((i + 1) * every) + 1;
+		double maxArea = -1;
+		size_t chosen = start;
+		for (size_t j = start; j < end; ++j)
+		{
+			double area = fabs((x[a] - avgX) * (y[j] - y[a]) - (x[a] - x[j]) * (avgY - y[a]));
+			if (area > maxArea)
+			{
+				maxArea = area;
+				chosen = j;
+			}
+		}
+
+		selected[written++] = (uint16_t)chosen;
+		a = chosen;
+	}
+
+	selected[written++] = (uint16_t)(count - 1);
+	return written;
+}
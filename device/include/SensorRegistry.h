@@ -0,0 +1,206 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <ArduinoJson.h>
+
+struct SensorInfo
+{
+	char name[32];
+	char unit[12];
+	char deviceClass[20];
+};
+
+using SensorRemoved = std::function<void(uint8_t slot)>;
+
+// Sensors learned from Home Assistant discovery (homeassistant/sensor/+/config).
+// State messages are routed to a slot with a single hash lookup on the topic.
+class SensorRegistry
+{
+public:
+	static constexpr size_t Capacity = 32;
+	static constexpr uint8_t NoSlot = 0xFF;
+
+	static bool isConfigTopic(const std::string& topic)
+	{
+		static const char suffix[] = "/config";
+		const size_t length = sizeof(suffix) - 1;
+		return topic.size() >= length && topic.compare(topic.size() - length, length, suffix) == 0;
+	}
+
+	// Told before a removed sensor's slot is handed out again, to reset what it keyed by slot
+	void setRemovalListener(const SensorRemoved listener)
+	{
+		onRemoved = listener;
+	}
+
+	// Adds, updates or (on an empty payload) removes the sensor described by a config message.
+	uint8_t onConfig(const std::string& configTopic, const std::string& payload)
+	{
+		auto existing = byConfigTopic.find(configTopic);
+		if (payload.empty())
+		{
+			if (existing != byConfigTopic.end())
+			{
+				const uint8_t slot = existing->second;
+				release(slot);
+				byConfigTopic.erase(existing);
+				if (onRemoved)
+				{
+					onRemoved(slot);
+				}
+			}
+			return NoSlot;
+		}
+
+		JsonDocument filter;
+		filter["~"] = true;
+		filter["name"] = true;
+		filter["state_topic"] = true;
+		filter["stat_t"] = true;
+		filter["unit_of_measurement"] = true;
+		filter["unit_of_meas"] = true;
+		filter["device_class"] = true;
+		filter["dev_cla"] = true;
+
+		JsonDocument doc;
+		if (deserializeJson(doc, payload, DeserializationOption::Filter(filter)))
+		{
+			return NoSlot;
+		}
+
+		std::string stateTopic = either(doc, "state_topic", "stat_t");
+		if (stateTopic.empty())
+		{
+			return NoSlot;
+		}
+		expandBase(stateTopic, doc["~"] | "");
+
+		uint8_t slot;
+		if (existing != byConfigTopic.end())
+		{
+			slot = existing->second;
+			byStateTopic.erase(stateTopics[slot]);
+		}
+		else
+		{
+			slot = allocate();
+			if (slot == NoSlot)
+			{
+				return NoSlot;
+			}
+			byConfigTopic[configTopic] = slot;
+		}
+
+		SensorInfo& sensor = sensors[slot];
+		copy(sensor.name, sizeof(sensor.name), doc["name"] | "");
+		copy(sensor.unit, sizeof(sensor.unit), either(doc, "unit_of_measurement", "unit_of_meas"));
+		copy(sensor.deviceClass, sizeof(sensor.deviceClass), either(doc, "device_class", "dev_cla"));
+
+		stateTopics[slot] = stateTopic;
+		byStateTopic[stateTopic] = slot;
+		return slot;
+	}
+
+	// Registers a sensor whose state topic is known at build time rather than discovered.
+	uint8_t registerSensor(const std::string& stateTopic, const char* name, const char* unit, const char* deviceClass)
+	{
+		uint8_t slot = allocate();
+		if (slot == NoSlot)
+		{
+			return NoSlot;
+		}
+
+		SensorInfo& sensor = sensors[slot];
+		copy(sensor.name, sizeof(sensor.name), name);
+		copy(sensor.unit, sizeof(sensor.unit), unit);
+		copy(sensor.deviceClass, sizeof(sensor.deviceClass), deviceClass);
+
+		stateTopics[slot] = stateTopic;
+		byStateTopic[stateTopic] = slot;
+		return slot;
+	}
+
+	uint8_t find(const std::string& stateTopic) const
+	{
+		auto it = byStateTopic.find(stateTopic);
+		return it == byStateTopic.end() ? NoSlot : it->second;
+	}
+
+	const SensorInfo& info(uint8_t slot) const
+	{
+		return sensors[slot];
+	}
+
+	const std::string& stateTopic(uint8_t slot) const
+	{
+		return stateTopics[slot];
+	}
+
+	size_t size() const
+	{
+		return byStateTopic.size();
+	}
+
+private:
+	std::array<SensorInfo, Capacity> sensors = {};
+	std::array<std::string, Capacity> stateTopics;
+	std::array<bool, Capacity> used = {};
+	std::unordered_map<std::string, uint8_t> byStateTopic;
+	std::unordered_map<std::string, uint8_t> byConfigTopic;
+	SensorRemoved onRemoved;
+
+	uint8_t allocate()
+	{
+		for (size_t i = 0; i < Capacity; ++i)
+		{
+			if (!used[i])
+			{
+				used[i] = true;
+				return (uint8_t)i;
+			}
+		}
+		return NoSlot;
+	}
+
+	void release(uint8_t slot)
+	{
+		byStateTopic.erase(stateTopics[slot]);
+		stateTopics[slot].clear();
+		sensors[slot] = {};
+		used[slot] = false;
+	}
+
+	// HA discovery allows "~" as an abbreviation for a shared base topic
+	static void expandBase(std::string& topic, const char* base)
+	{
+		if (*base == '\0')
+		{
+			return;
+		}
+		if (topic.front() == '~')
+		{
+			topic.replace(0, 1, base);
+		}
+		else if (topic.back() == '~')
+		{
+			topic.replace(topic.size() - 1, 1, base);
+		}
+	}
+
+	// Discovery keys may be sent in full or abbreviated form
+	static const char* either(const JsonDocument& doc, const char* key, const char* abbreviation)
+	{
+		const char* value = doc[key] | (const char*)nullptr;
+		return value ? value : doc[abbreviation] | "";
+	}
+
+	static void copy(char* dest, size_t size, const char* src)
+	{
+		strncpy(dest, src, size - 1);
+		dest[size - 1] = '\0';
+	}
+};
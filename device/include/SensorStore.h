@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Latest value per sensor slot, kept as parallel arrays so scans only touch
+// the fields they need. Writers mark slots dirty for the UI, and bump a
+// sequence counter around each write so another task can take a consistent
+// snapshot without locking (seqlock: odd while a write is in progress).
+template <size_t Capacity>
+class SensorStore
+{
+public:
+	enum Flags : uint8_t
+	{
+		Valid = 0x01,
+		Unavailable = 0x02,
+	};
+
+	struct Snapshot
+	{
+		std::array<float, Capacity> values;
+		std::array<uint32_t, Capacity> timestamps;
+		std::array<uint8_t, Capacity> flags;
+		std::array<uint8_t, Capacity> unitIds;
+		uint32_t sequence;
+	};
+
+	void update(size_t slot, float value, uint32_t timestamp, uint8_t unitId, uint8_t slotFlags = Valid)
+	{
+		beginWrite();
+		values[slot] = value;
+		timestamps[slot] = timestamp;
+		flags[slot] = slotFlags;
+		unitIds[slot] = unitId;
+		endWrite();
+
+		dirty[slot / 32] |= 1u << (slot % 32);
+	}
+
+	void setFlags(size_t slot, uint8_t slotFlags)
+	{
+		beginWrite();
+		flags[slot] = slotFlags;
+		endWrite();
+
+		dirty[slot / 32] |= 1u << (slot % 32);
+	}
+
+	// Forgets a slot's value, e.g. when its sensor is removed and the slot reused
+	void clear(size_t slot)
+	{
+		beginWrite();
+		values[slot] = 0;
+		timestamps[slot] = 0;
+		flags[slot] = 0;
+		unitIds[slot] = 0;
+		endWrite();
+
+		dirty[slot / 32] &= ~(1u << (slot % 32));
+	}
+
+	// Visits and clears every dirty slot; cost scales with the words scanned, not the slot count.
+	template <typename Fn>
+	void forEachDirty(Fn&& fn)
+	{
+		for (size_t word = 0; word < dirty.size(); ++word)
+		{
+			uint32_t bits = dirty[word];
+			dirty[word] = 0;
+			while (bits != 0)
+			{
+				fn(word * 32 + __builtin_ctz(bits));
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	bool anyDirty() const
+	{
+		for (uint32_t word : dirty)
+		{
+			if (word != 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Copies the store, retrying while a write overlaps the copy.
+	void snapshot(Snapshot& out) const
+	{
+		uint32_t before;
+		do
+		{
+			before = sequence.load(std::memory_order_acquire);
+			if (before & 1)
+			{
+				continue;
+			}
+			memcpy(out.values.data(), values.data(), sizeof(values));
+			memcpy(out.timestamps.data(), timestamps.data(), sizeof(timestamps));
+			memcpy(out.flags.data(), flags.data(), sizeof(flags));
+			memcpy(out.unitIds.data(), unitIds.data(), sizeof(unitIds));
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((before & 1) || sequence.load(std::memory_order_relaxed) != before);
+
+		out.sequence = before;
+	}
+
+	float value(size_t slot) const { return values[slot]; }
+	uint32_t timestamp(size_t slot) const { return timestamps[slot]; }
+	uint8_t flagsOf(size_t slot) const { return flags[slot]; }
+	uint8_t unitId(size_t slot) const { return unitIds[slot]; }
+
+private:
+	std::array<float, Capacity> values = {};
+	std::array<uint32_t, Capacity> timestamps = {};
+	std::array<uint8_t, Capacity> flags = {};
+	std::array<uint8_t, Capacity> unitIds = {};
+	std::array<uint32_t, (Capacity + 31) / 32> dirty = {};
+	std::atomic<uint32_t> sequence{0};
+
+	void beginWrite()
+	{
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void endWrite()
+	{
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+};
+
+// Interns unit strings ("°C", "%", "W") into the small ids stored per slot.
+class UnitTable
+{
+public:
+	static constexpr size_t Capacity = 16;
+	static constexpr uint8_t NoUnit = 0xFF;
+
+	uint8_t intern(const char* unit)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (strcmp(units[i], unit) == 0)
+			{
+				return (uint8_t)i;
+			}
+		}
+		if (count == Capacity)
+		{
+			return NoUnit;
+		}
+		strncpy(units[count], unit, sizeof(units[count]) - 1);
+		return (uint8_t)count++;
+	}
+
+	const char* name(uint8_t id) const
+	{
+		return id < count ? units[id] : "";
+	}
+
+private:
+	char units[Capacity][12] = {};
+	size_t count = 0;
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "PayloadParser.h"
+#include "TopicTokenizer.h"
+#include "TraceRing.h"
+#include "AllocTracker.h"
+
+// Topic routing for patterns fixed at build time: checked and split while compiling, handlers
+// inlined. Patterns with runtime parts (cyd/<device>/...) stay with MQTTDispatcher.
+namespace StaticRouting
+{
+	class Pattern
+	{
+	public:
+		static constexpr size_t Capacity = TopicTokenizer::Levels::Capacity;
+
+		enum Kind : uint8_t
+		{
+			Literal,
+			SingleLevel, // +
+			MultiLevel,  // #, always the last level
+		};
+
+		constexpr Pattern(const char* filter) : text(filter)
+		{
+			size_t start = 0;
+			for (size_t i = 0;; ++i)
+			{
+				const char c = filter[i];
+				if (c == '+' || c == '#')
+				{
+					// A wildcard fills its whole level, and # can only be the last one
+					const bool alone = i == start && (filter[i + 1] == '/' || filter[i + 1] == '\0');
+					if (!alone || (c == '#' && filter[i + 1] != '\0'))
+					{
+						invalidTopicFilter("wildcard must fill its level and # must come last");
+						return;
+					}
+				}
+				if (c != '/' && c != '\0')
+				{
+					continue;
+				}
+				if (count == Capacity || i > UINT8_MAX)
+				{
+					invalidTopicFilter("filter deeper or longer than TopicTokenizer can hold");
+					return;
+				}
+				start_[count] = (uint8_t)start;
+				length_[count] = (uint8_t)(i - start);
+				kind_[count] = i - start == 1 && filter[start] == '+' ? SingleLevel
+				             : i - start == 1 && filter[start] == '#' ? MultiLevel
+				                                                      : Literal;
+				++count;
+				start = i + 1;
+				if (c == '\0')
+				{
+					break;
+				}
+			}
+			if (count == 1 && length_[0] == 0)
+			{
+				invalidTopicFilter("empty filter");
+				return;
+			}
+			valid = true;
+		}
+
+		// Same rules as MQTTDispatcher::match()
+		bool matches(const TopicTokenizer::Levels& topic) const
+		{
+			size_t i = 0;
+			for (; i < count; ++i)
+			{
+				if (kind_[i] == MultiLevel)
+				{
+					return true;
+				}
+				if (i >= topic.count)
+				{
+					return false;
+				}
+				if (kind_[i] == Literal &&
+				    (topic.length[i] != length_[i] || memcmp(topic.text + topic.start[i], text + start_[i], length_[i]) != 0))
+				{
+					return false;
+				}
+			}
+			return i == topic.count && !topic.truncated;
+		}
+
+		const char* filter() const { return text; }
+		constexpr size_t levels() const { return count; }
+		constexpr Kind kind(size_t level) const { return kind_[level]; }
+		constexpr bool isValid() const { return valid; }
+
+	private:
+		// Deliberately not constexpr: reaching it while a constexpr router is being
+		// built turns a malformed pattern into a compile error that names it
+		void invalidTopicFilter(const char* /*reason*/)
+		{
+			count = 0;
+		}
+
+		const char* text;
+		uint8_t start_[Capacity] = {};
+		uint8_t length_[Capacity] = {};
+		Kind kind_[Capacity] = {};
+		uint8_t count = 0;
+		bool valid = false;
+	};
+
+	template <typename H>
+	struct Route
+	{
+		Pattern pattern;
+		H handler;
+	};
+
+	template <typename H>
+	constexpr Route<H> route(const char* filter, H handler)
+	{
+		return Route<H>{Pattern(filter), handler};
+	}
+
+	template <typename... Routes>
+	class Router
+	{
+	public:
+		constexpr explicit Router(Routes... routes) : routes(routes...) {}
+
+		static constexpr size_t size() { return sizeof...(Routes); }
+
+		// Returns whether any matching handler used the message
+		bool dispatch(const std::string& topic, const std::string& payload) const
+		{
+			return dispatch(topic, TopicTokenizer::tokenize(topic), payload);
+		}
+
+		bool dispatch(const std::string& topic, const TopicTokenizer::Levels& levels, const std::string& payload) const
+		{
+			Message message{topic, levels, payload};
+			deliverAll(message, std::index_sequence_for<Routes...>());
+			return message.used;
+		}
+
+		// Calls fn(filter) for every pattern, e.g. to subscribe them
+		template <typename Fn>
+		void forEachFilter(Fn&& fn) const
+		{
+			std::apply([&fn](const Routes&... each) { (fn(each.pattern.filter()), ...); }, routes);
+		}
+
+	private:
+		struct Message
+		{
+			const std::string& topic;
+			const TopicTokenizer::Levels& levels;
+			const std::string& payload;
+			ParsedPayload parsed = {};
+			bool isParsed = false;
+			bool used = false;
+		};
+
+		template <size_t... Index>
+		void deliverAll(Message& message, std::index_sequence<Index...>) const
+		{
+			(deliver(std::get<Index>(routes), Index, message), ...);
+		}
+
+		template <typename H>
+		static void deliver(const Route<H>& route, [[maybe_unused]] size_t index, Message& message)
+		{
+			if (!route.pattern.matches(message.levels))
+			{
+				return;
+			}
+			TRACE_SCOPE_ARG(Handler, index);
+			ALLOC_SCOPE(Handler);
+			if constexpr (std::is_invocable_v<const H&, const std::string&, const ParsedPayload&>)
+			{
+				if (!message.isParsed)
+				{
+					message.parsed = parsePayload(message.payload.data(), message.payload.size());
+					message.isParsed = true;
+				}
+				message.used |= call(route.handler, message.topic, message.parsed);
+			}
+			else
+			{
+				message.used |= call(route.handler, message.topic, message.payload);
+			}
+		}
+
+		template <typename H, typename Payload>
+		static bool call(const H& handler, const std::string& topic, const Payload& payload)
+		{
+			if constexpr (std::is_same_v<std::invoke_result_t<const H&, const std::string&, const Payload&>, bool>)
+			{
+				return handler(topic, payload);
+			}
+			else
+			{
+				handler(topic, payload);
+				return true;
+			}
+		}
+
+		std::tuple<Routes...> routes;
+	};
+
+	template <typename... Routes>
+	constexpr Router<Routes...> makeRouter(Routes... routes)
+	{
+		return Router<Routes...>(routes...);
+	}
+}
@@ -0,0 +1,351 @@
+#pragma once
+#include <Client.h>
+#include <functional>
+#include <string>
+
+using ChunkSink = std::function<void(const std::string& topic, const uint8_t* data, size_t length, size_t offset, size_t total)>;
+
+// Hands PUBLISH packets too large for PubSubClient's buffer to a ChunkSink as they
+// arrive; everything else passes through to PubSubClient untouched.
+class StreamingClient : public Client
+{
+public:
+	struct Stats
+	{
+		uint32_t oversized;   // PUBLISH packets intercepted
+		uint32_t dropped;     // Intercepted but discarded (no sink, topic too long)
+		uint32_t largestPayload;
+	};
+
+	static constexpr size_t ChunkSize = 256;
+	static constexpr size_t MaxTopicLength = 192;
+
+	explicit StreamingClient(Client& inner) : inner(inner)
+	{
+	}
+
+	// Packets of at least this many bytes (PubSubClient's buffer size) are streamed instead.
+	void setPassthroughLimit(size_t bytes)
+	{
+		limit = bytes;
+	}
+
+	void setChunkSink(const ChunkSink chunkSink)
+	{
+		sink = chunkSink;
+	}
+
+	const Stats& statistics() const
+	{
+		return stats;
+	}
+
+	// Session-present flag of the last CONNACK, which PubSubClient reads but does not expose
+	bool sessionPresent() const
+	{
+		return sessionFlag;
+	}
+
+	int connect(IPAddress ip, uint16_t port) override
+	{
+		reset();
+		return inner.connect(ip, port);
+	}
+
+	int connect(const char* host, uint16_t port) override
+	{
+		reset();
+		return inner.connect(host, port);
+	}
+
+	size_t write(uint8_t b) override { return inner.write(b); }
+	size_t write(const uint8_t* buf, size_t size) override { return inner.write(buf, size); }
+	void flush() override { inner.flush(); }
+	uint8_t connected() override { return inner.connected(); }
+	operator bool() override { return (bool)inner; }
+
+	void stop() override
+	{
+		reset();
+		inner.stop();
+	}
+
+	int available() override
+	{
+		pump();
+		if (state != Passthrough)
+		{
+			return 0;
+		}
+		int pending = inner.available();
+		pending = pending < 0 ? 0 : pending;
+		return (int)(headerLength - headerServed) + (int)(remaining < (uint32_t)pending ? remaining : (uint32_t)pending);
+	}
+
+	int read() override
+	{
+		uint8_t b;
+		return read(&b, 1) == 1 ? b : -1;
+	}
+
+	int read(uint8_t* buf, size_t size) override
+	{
+		pump();
+		if (state != Passthrough)
+		{
+			return -1;
+		}
+
+		size_t copied = 0;
+		while (copied < size && headerServed < headerLength)
+		{
+			buf[copied++] = header[headerServed++];
+		}
+		if (copied < size && remaining > 0)
+		{
+			size_t want = size - copied < remaining ? size - copied : remaining;
+			int n = inner.read(buf + copied, want);
+			if (n > 0)
+			{
+				if ((header[0] & 0xF0) == 0x20 && remaining == 2)
+				{
+					sessionFlag = buf[copied] & 0x01;
+				}
+				copied += n;
+				remaining -= n;
+			}
+		}
+
+		if (headerServed == headerLength && remaining == 0)
+		{
+			state = Header;
+			headerLength = 0;
+		}
+		return copied > 0 ? (int)copied : -1;
+	}
+
+	int peek() override
+	{
+		pump();
+		if (state != Passthrough)
+		{
+			return -1;
+		}
+		if (headerServed < headerLength)
+		{
+			return header[headerServed];
+		}
+		return remaining > 0 ? inner.peek() : -1;
+	}
+
+private:
+	enum State : uint8_t
+	{
+		Header,
+		Passthrough,
+		TopicLength,
+		Topic,
+		PacketId,
+		Payload,
+	};
+
+	Client& inner;
+	ChunkSink sink;
+	size_t limit = 256;
+	Stats stats = {};
+
+	State state = Header;
+	uint8_t header[5];
+	size_t headerLength = 0;
+	size_t headerServed = 0;
+	uint32_t remaining = 0;
+	uint32_t multiplier = 1;
+	bool sessionFlag = false;
+
+	// Intercepted PUBLISH
+	std::string topic;
+	uint16_t fieldValue = 0;
+	uint8_t fieldBytes = 0;
+	uint16_t topicLength = 0;
+	uint16_t packetId = 0;
+	uint8_t qos = 0;
+	bool discard = false;
+	uint32_t payloadTotal = 0;
+	uint32_t payloadOffset = 0;
+
+	void reset()
+	{
+		sessionFlag = false;
+		state = Header;
+		headerLength = 0;
+		headerServed = 0;
+		remaining = 0;
+	}
+
+	// Advances the parser over whatever has arrived without blocking.
+	void pump()
+	{
+		while (state != Passthrough && inner.available() > 0)
+		{
+			switch (state)
+			{
+			case Header:
+				readHeaderByte();
+				break;
+			case TopicLength:
+			case PacketId:
+				readFieldByte();
+				break;
+			case Topic:
+				readTopicByte();
+				break;
+			case Payload:
+				readPayload();
+				break;
+			default:
+				return;
+			}
+		}
+	}
+
+	void readHeaderByte()
+	{
+		const uint8_t b = (uint8_t)inner.read();
+		header[headerLength++] = b;
+		if (headerLength == 1)
+		{
+			remaining = 0;
+			multiplier = 1;
+			return;
+		}
+
+		remaining += (b & 0x7F) * multiplier;
+		multiplier *= 128;
+		if ((b & 0x80) && headerLength < sizeof(header))
+		{
+			return;
+		}
+
+		headerServed = 0;
+		const bool publish = (header[0] & 0xF0) == 0x30;
+		if (!publish || headerLength + remaining < limit)
+		{
+			state = Passthrough;
+			return;
+		}
+
+		// Oversized PUBLISH: parse it ourselves
+		++stats.oversized;
+		qos = (header[0] >> 1) & 0x03;
+		topic.clear();
+		fieldValue = 0;
+		fieldBytes = 0;
+		state = TopicLength;
+	}
+
+	void readFieldByte()
+	{
+		fieldValue = (uint16_t)((fieldValue << 8) | (uint8_t)inner.read());
+		--remaining;
+		if (++fieldBytes < 2)
+		{
+			return;
+		}
+
+		fieldBytes = 0;
+		if (state == TopicLength)
+		{
+			topicLength = fieldValue;
+			discard = topicLength > MaxTopicLength || !sink;
+			if (topicLength > 0)
+			{
+				state = Topic;
+			}
+			else if ((state = afterTopic()) == Payload)
+			{
+				beginPayload();
+			}
+		}
+		else
+		{
+			packetId = fieldValue;
+			beginPayload();
+		}
+		fieldValue = 0;
+	}
+
+	void readTopicByte()
+	{
+		const char c = (char)inner.read();
+		--remaining;
+		if (topic.size() < MaxTopicLength)
+		{
+			topic.push_back(c);
+		}
+		if (--topicLength == 0)
+		{
+			state = afterTopic();
+			if (state == Payload)
+			{
+				beginPayload();
+			}
+		}
+	}
+
+	State afterTopic()
+	{
+		return qos > 0 ? PacketId : Payload;
+	}
+
+	void beginPayload()
+	{
+		state = Payload;
+		payloadTotal = remaining;
+		payloadOffset = 0;
+		stats.largestPayload = payloadTotal > stats.largestPayload ? payloadTotal : stats.largestPayload;
+		if (discard)
+		{
+			++stats.dropped;
+		}
+		if (remaining == 0)
+		{
+			finish();
+		}
+	}
+
+	void readPayload()
+	{
+		uint8_t chunk[ChunkSize];
+		while (remaining > 0 && inner.available() > 0)
+		{
+			int n = inner.read(chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+			if (n <= 0)
+			{
+				return;
+			}
+			if (!discard)
+			{
+				sink(topic, chunk, (size_t)n, payloadOffset, payloadTotal);
+			}
+			payloadOffset += n;
+			remaining -= n;
+		}
+
+		if (remaining == 0)
+		{
+			finish();
+		}
+	}
+
+	void finish()
+	{
+		if (qos == 1)
+		{
+			// PubSubClient never saw this packet, so acknowledge it ourselves
+			const uint8_t puback[] = {0x40, 0x02, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+			inner.write(puback, sizeof(puback));
+		}
+		state = Header;
+		headerLength = 0;
+	}
+};
@@ -0,0 +1,335 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Page-granular storage the log is written to. Segments are erased as a whole
+// and their pages written once each, in order, like flash erase blocks.
+class LogStorage
+{
+public:
+	static constexpr size_t PageSize = 512;
+
+	virtual ~LogStorage() = default;
+	virtual uint16_t segmentCount() const = 0;
+	virtual uint16_t pagesPerSegment() const = 0;
+	virtual bool readPage(uint16_t segment, uint16_t page, uint8_t* data) = 0;
+	virtual bool writePage(uint16_t segment, uint16_t page, const uint8_t* data) = 0;
+	virtual bool eraseSegment(uint16_t segment) = 0;
+};
+
+struct LogRecord
+{
+	uint32_t timestamp; // Unix seconds, or seconds since boot when flags has UptimeClock
+	float value;
+	uint16_t slot;
+	uint16_t flags;
+
+	static constexpr uint16_t UptimeClock = 0x0001;
+};
+
+// Append-only ring of fixed-size records over LogStorage. Records are batched
+// in RAM and written a full page at a time; segments are reused round-robin,
+// so every segment sees the same number of erases. Only the unflushed page is
+// lost on power failure.
+class TimeSeriesLog
+{
+public:
+	static constexpr size_t RecordsPerPage = (LogStorage::PageSize - 12) / sizeof(LogRecord);
+
+	struct Stats
+	{
+		uint32_t recordsAppended;
+		uint32_t pagesWritten;
+		uint32_t segmentsErased;
+		uint32_t writeErrors;
+	};
+
+	// Position of a streaming export, one page per step
+	struct Cursor
+	{
+		uint32_t sequence; // Next page sequence to read
+		bool done;
+	};
+
+	explicit TimeSeriesLog(LogStorage& storage) : storage(storage)
+	{
+	}
+
+	// Recovers the write position by finding the segment holding the newest page.
+	void begin()
+	{
+		nextSequence = 0;
+		writeSegment = 0;
+		writePage = 0;
+
+		PageHeader header;
+		for (uint16_t segment = 0; segment < storage.segmentCount(); ++segment)
+		{
+			for (uint16_t page = 0; page < storage.pagesPerSegment(); ++page)
+			{
+				if (!readHeader(segment, page, header))
+				{
+					break;
+				}
+				if (header.sequence + 1 > nextSequence)
+				{
+					nextSequence = header.sequence + 1;
+					writeSegment = segment;
+					writePage = page + 1;
+				}
+			}
+		}
+
+		if (nextSequence > 0 && writePage >= storage.pagesPerSegment())
+		{
+			advanceSegment();
+		}
+	}
+
+	void append(uint16_t slot, uint32_t timestamp, float value, uint16_t flags = 0)
+	{
+		pending[pendingCount++] = {timestamp, value, slot, flags};
+		++stats.recordsAppended;
+		if (pendingCount == RecordsPerPage)
+		{
+			flush();
+		}
+	}
+
+	// Writes the buffered records as one (possibly partial) page.
+	bool flush()
+	{
+		if (pendingCount == 0)
+		{
+			return true;
+		}
+
+		if (writePage == 0 && !storage.eraseSegment(writeSegment))
+		{
+			++stats.writeErrors;
+			return false;
+		}
+		if (writePage == 0)
+		{
+			++stats.segmentsErased;
+		}
+
+		uint8_t page[LogStorage::PageSize];
+		memset(page, 0xFF, sizeof(page));
+		PageHeader header = {Magic, nextSequence, (uint16_t)pendingCount, 0};
+		memcpy(page + sizeof(PageHeader), pending, pendingCount * sizeof(LogRecord));
+		header.checksum = checksum(page + sizeof(PageHeader), pendingCount * sizeof(LogRecord));
+		memcpy(page, &header, sizeof(header));
+
+		if (!storage.writePage(writeSegment, writePage, page))
+		{
+			++stats.writeErrors;
+			return false;
+		}
+
+		++stats.pagesWritten;
+		++nextSequence;
+		pendingCount = 0;
+		if (++writePage == storage.pagesPerSegment())
+		{
+			advanceSegment();
+		}
+		return true;
+	}
+
+	Cursor beginExport() const
+	{
+		// Once the ring has wrapped, the segment being filled has lost its older pages
+		const uint32_t capacity = (uint32_t)storage.segmentCount() * storage.pagesPerSegment();
+		const uint32_t stored = writePage == 0 ? capacity : capacity - storage.pagesPerSegment() + writePage;
+		return {nextSequence > stored ? nextSequence - stored : 0, nextSequence == 0};
+	}
+
+	// Reads the next stored page into `records`; returns the record count, 0 once done.
+	size_t exportNext(Cursor& cursor, LogRecord* records)
+	{
+		while (!cursor.done)
+		{
+			if (cursor.sequence >= nextSequence)
+			{
+				cursor.done = true;
+				break;
+			}
+
+			const uint32_t sequence = cursor.sequence++;
+			uint16_t segment;
+			uint16_t page;
+			locate(sequence, segment, page);
+
+			uint8_t data[LogStorage::PageSize];
+			if (!storage.readPage(segment, page, data))
+			{
+				continue;
+			}
+
+			PageHeader header;
+			memcpy(&header, data, sizeof(header));
+			// A valid page from another pass of the ring (overwritten, or erased and
+			// rewritten at this slot) is stale too
+			if (header.magic != Magic || header.sequence != sequence || header.count > RecordsPerPage ||
+			    header.checksum != checksum(data + sizeof(PageHeader), header.count * sizeof(LogRecord)))
+			{
+				continue; // Torn or stale page, skip it
+			}
+
+			memcpy(records, data + sizeof(PageHeader), header.count * sizeof(LogRecord));
+			return header.count;
+		}
+		return 0;
+	}
+
+	const Stats& statistics() const
+	{
+		return stats;
+	}
+
+	size_t pendingRecords() const
+	{
+		return pendingCount;
+	}
+
+private:
+	static constexpr uint32_t Magic = 0x4C535443; // "CTSL"
+
+	struct PageHeader
+	{
+		uint32_t magic;
+		uint32_t sequence;
+		uint16_t count;
+		uint16_t checksum;
+	};
+	static_assert(sizeof(PageHeader) == 12, "page header layout");
+	static_assert(sizeof(LogRecord) == 12, "record layout");
+
+	LogStorage& storage;
+	LogRecord pending[RecordsPerPage];
+	size_t pendingCount = 0;
+	uint32_t nextSequence = 0;
+	uint16_t writeSegment = 0;
+	uint16_t writePage = 0;
+	Stats stats = {};
+
+	void advanceSegment()
+	{
+		writeSegment = (writeSegment + 1) % storage.segmentCount();
+		writePage = 0;
+	}
+
+	// Pages are laid out in sequence order around the ring, so the location is arithmetic
+	void locate(uint32_t sequence, uint16_t& segment, uint16_t& page) const
+	{
+		const uint32_t newest = nextSequence - 1;
+		const uint32_t newestSlot = (uint32_t)writeSegment * storage.pagesPerSegment() + writePage +
+			(writePage == 0 ? (uint32_t)storage.segmentCount() * storage.pagesPerSegment() : 0) - 1;
+		const uint32_t capacity = (uint32_t)storage.segmentCount() * storage.pagesPerSegment();
+		const uint32_t slot = (newestSlot + capacity - (newest - sequence) % capacity) % capacity;
+		segment = slot / storage.pagesPerSegment();
+		page = slot % storage.pagesPerSegment();
+	}
+
+	bool readHeader(uint16_t segment, uint16_t page, PageHeader& header)
+	{
+		uint8_t data[LogStorage::PageSize];
+		if (!storage.readPage(segment, page, data))
+		{
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+		return header.magic == Magic;
+	}
+
+	// Fletcher-16, enough to spot torn page writes
+	static uint16_t checksum(const uint8_t* data, size_t length)
+	{
+		uint16_t a = 0;
+		uint16_t b = 0;
+		for (size_t i = 0; i < length; ++i)
+		{
+			a = (a + data[i]) % 255;
+			b = (b + a) % 255;
+		}
+		return (uint16_t)((b << 8) | a);
+	}
+};
+
+// Single file laid out as an erasable block device: erase fills a segment with
+// 0xFF, pages are written in place. Counts erases per segment so host tools can
+// check wear distribution.
+class FileLogStorage : public LogStorage
+{
+public:
+	FileLogStorage(const char* path, uint16_t segments, uint16_t pagesPerSegment)
+		: segments(segments), pages(pagesPerSegment), erases(segments, 0)
+	{
+		file = fopen(path, "r+b");
+		if (!file)
+		{
+			file = fopen(path, "w+b");
+			uint8_t blank[PageSize];
+			memset(blank, 0xFF, sizeof(blank));
+			for (uint32_t i = 0; file && i < (uint32_t)segments * pages; ++i)
+			{
+				fwrite(blank, 1, sizeof(blank), file);
+			}
+		}
+	}
+
+	~FileLogStorage() override
+	{
+		if (file)
+		{
+			fclose(file);
+		}
+	}
+
+	uint16_t segmentCount() const override { return segments; }
+	uint16_t pagesPerSegment() const override { return pages; }
+
+	bool readPage(uint16_t segment, uint16_t page, uint8_t* data) override
+	{
+		return file && fseek(file, offset(segment, page), SEEK_SET) == 0 && fread(data, 1, PageSize, file) == PageSize;
+	}
+
+	bool writePage(uint16_t segment, uint16_t page, const uint8_t* data) override
+	{
+		return file && fseek(file, offset(segment, page), SEEK_SET) == 0 && fwrite(data, 1, PageSize, file) == PageSize;
+	}
+
+	bool eraseSegment(uint16_t segment) override
+	{
+		uint8_t blank[PageSize];
+		memset(blank, 0xFF, sizeof(blank));
+		for (uint16_t page = 0; page < pages; ++page)
+		{
+			if (!writePage(segment, page, blank))
+			{
+				return false;
+			}
+		}
+		++erases[segment];
+		return true;
+	}
+
+	const std::vector<uint32_t>& eraseCounts() const
+	{
+		return erases;
+	}
+
+private:
+	FILE* file = nullptr;
+	uint16_t segments;
+	uint16_t pages;
+	std::vector<uint32_t> erases;
+
+	long offset(uint16_t segment, uint16_t page) const
+	{
+		return ((long)segment * pages + page) * (long)PageSize;
+	}
+};
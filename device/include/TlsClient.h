@@ -0,0 +1,435 @@
+#pragma once
+#include <Arduino.h>
+#include <Client.h>
+#include <cstring>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/version.h>
+#include <mbedtls/x509_crt.h>
+
+// TLS over any Client, built directly on mbedTLS so that the negotiated session
+// (ticket or ID) can be kept across reconnects: a resumed handshake skips the
+// certificate chain and the key exchange, which is most of the time and heap a
+// full handshake costs on the ESP32. Authenticates either with a CA
+// certificate or with a pre-shared key, which needs no certificates at all.
+class TlsClient : public Client
+{
+public:
+	// Milliseconds spent per phase of the last connect
+	struct HandshakeTiming
+	{
+		uint32_t tcp;          // TCP connect
+		uint32_t hello;        // ClientHello until ServerHello parsed (one round trip)
+		uint32_t serverAuth;   // Server certificate, key exchange params and chain verification
+		uint32_t keyExchange;  // Client key exchange and its ECDHE/RSA computation
+		uint32_t finish;       // ChangeCipherSpec/Finished in both directions
+		uint32_t total;
+		uint32_t heapUsed;     // Free heap consumed by the established connection
+		bool resumed;
+	};
+
+	struct Stats
+	{
+		uint32_t fullHandshakes;
+		uint32_t resumedHandshakes;
+		uint32_t failures;
+		int lastError;         // mbedTLS error code of the last failure
+	};
+
+	static constexpr uint32_t HandshakeTimeoutMs = 10000;
+
+	explicit TlsClient(Client& inner) : inner(inner)
+	{
+	}
+
+	~TlsClient() override
+	{
+		stop();
+		if (configured)
+		{
+			mbedtls_ssl_session_free(&session);
+			mbedtls_ssl_free(&ssl);
+			mbedtls_ssl_config_free(&conf);
+			mbedtls_x509_crt_free(&ca);
+			mbedtls_ctr_drbg_free(&drbg);
+			mbedtls_entropy_free(&entropy);
+		}
+	}
+
+	// PEM CA certificate the broker's chain must verify against; must outlive the client
+	void useCertificate(const char* caPem)
+	{
+		caCertificate = caPem;
+		pskIdentity = nullptr;
+	}
+
+	// TLS-PSK: no certificates, the key is shared with the broker's psk_file
+	void usePsk(const char* identity, const uint8_t* key, size_t keyLength)
+	{
+		pskIdentity = identity;
+		pskKey = key;
+		pskKeyLength = keyLength;
+		caCertificate = nullptr;
+	}
+
+	// Drops the cached session so the next connect performs a full handshake
+	void forgetSession()
+	{
+		haveSession = false;
+	}
+
+	const HandshakeTiming& lastHandshake() const
+	{
+		return timing;
+	}
+
+	const Stats& statistics() const
+	{
+		return stats;
+	}
+
+	int connect(IPAddress ip, uint16_t port) override
+	{
+		return open(ip.toString().c_str(), [&]() { return inner.connect(ip, port); });
+	}
+
+	int connect(const char* host, uint16_t port) override
+	{
+		return open(host, [&]() { return inner.connect(host, port); });
+	}
+
+	size_t write(uint8_t b) override
+	{
+		return write(&b, 1);
+	}
+
+	size_t write(const uint8_t* buf, size_t size) override
+	{
+		if (!established)
+		{
+			return 0;
+		}
+
+		size_t written = 0;
+		while (written < size)
+		{
+			int n = mbedtls_ssl_write(&ssl, buf + written, size - written);
+			if ((n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE) && inner.connected())
+			{
+				continue;
+			}
+			if (n < 0)
+			{
+				fail(n);
+				break;
+			}
+			written += n;
+		}
+		return written;
+	}
+
+	int available() override
+	{
+		if (!established)
+		{
+			return 0;
+		}
+
+		size_t pending = mbedtls_ssl_get_bytes_avail(&ssl);
+		if (pending == 0 && inner.available() > 0)
+		{
+			// Decrypt the next record without consuming any of it
+			int n = mbedtls_ssl_read(&ssl, nullptr, 0);
+			if (n < 0 && n != MBEDTLS_ERR_SSL_WANT_READ && n != MBEDTLS_ERR_SSL_WANT_WRITE)
+			{
+				fail(n);
+				return 0;
+			}
+			pending = mbedtls_ssl_get_bytes_avail(&ssl);
+		}
+		return (int)pending;
+	}
+
+	int read() override
+	{
+		uint8_t b;
+		return read(&b, 1) == 1 ? b : -1;
+	}
+
+	int read(uint8_t* buf, size_t size) override
+	{
+		if (!established)
+		{
+			return -1;
+		}
+
+		int n = mbedtls_ssl_read(&ssl, buf, size);
+		if (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE)
+		{
+			return -1;
+		}
+		if (n <= 0)
+		{
+			fail(n);
+			return -1;
+		}
+		return n;
+	}
+
+	int peek() override
+	{
+		// PubSubClient never peeks; TLS records cannot be inspected without consuming them
+		return -1;
+	}
+
+	void flush() override
+	{
+		inner.flush();
+	}
+
+	uint8_t connected() override
+	{
+		return established && inner.connected();
+	}
+
+	operator bool() override
+	{
+		return connected();
+	}
+
+	void stop() override
+	{
+		if (established)
+		{
+			mbedtls_ssl_close_notify(&ssl);
+			established = false;
+		}
+		inner.stop();
+	}
+
+private:
+	enum Phase : uint8_t
+	{
+		Hello,
+		ServerAuth,
+		KeyExchange,
+		Finish,
+	};
+
+	Client& inner;
+	const char* caCertificate = nullptr;
+	const char* pskIdentity = nullptr;
+	const uint8_t* pskKey = nullptr;
+	size_t pskKeyLength = 0;
+
+	bool configured = false;
+	bool established = false;
+	bool haveSession = false;
+	mbedtls_entropy_context entropy;
+	mbedtls_ctr_drbg_context drbg;
+	mbedtls_x509_crt ca;
+	mbedtls_ssl_config conf;
+	mbedtls_ssl_context ssl;
+	mbedtls_ssl_session session;
+
+	HandshakeTiming timing = {};
+	Stats stats = {};
+
+	template <typename TcpConnect>
+	int open(const char* host, TcpConnect tcpConnect)
+	{
+		stop();
+		timing = {};
+		const uint32_t heapBefore = ESP.getFreeHeap();
+		const uint32_t start = millis();
+
+		if (!configure())
+		{
+			return 0;
+		}
+		if (!tcpConnect())
+		{
+			++stats.failures;
+			return 0;
+		}
+		timing.tcp = millis() - start;
+
+		mbedtls_ssl_session_reset(&ssl);
+		mbedtls_ssl_set_hostname(&ssl, host);
+		mbedtls_ssl_set_bio(&ssl, this, send, receive, nullptr);
+		const bool offered = haveSession && mbedtls_ssl_set_session(&ssl, &session) == 0;
+
+		// Step the handshake ourselves so the time of every state can be attributed. Its
+		// path also tells a resumption apart: the server accepted the offered session when
+		// ServerHello leads straight to its ChangeCipherSpec, with no ServerHelloDone. A
+		// missing certificate step alone proves nothing, as PSK never has one.
+		int afterServerHello = -1;
+		bool sawServerHelloDone = false;
+		while (handshakeState() != MBEDTLS_SSL_HANDSHAKE_OVER)
+		{
+			if (millis() - start > HandshakeTimeoutMs || !inner.connected())
+			{
+				fail(MBEDTLS_ERR_SSL_TIMEOUT);
+				return 0;
+			}
+
+			const int state = handshakeState();
+			sawServerHelloDone |= state == MBEDTLS_SSL_SERVER_HELLO_DONE;
+			const uint32_t stepStart = millis();
+			int ret = mbedtls_ssl_handshake_step(&ssl);
+			if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+			{
+				fail(ret);
+				return 0;
+			}
+			if (ret == MBEDTLS_ERR_SSL_WANT_READ)
+			{
+				delay(1); // Let the network stack deliver the peer's flight
+			}
+			if (state == MBEDTLS_SSL_SERVER_HELLO && handshakeState() != state)
+			{
+				afterServerHello = handshakeState();
+			}
+			phaseTime(phaseOf(state)) += millis() - stepStart;
+		}
+
+		timing.resumed = offered && afterServerHello == MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC && !sawServerHelloDone;
+		++(timing.resumed ? stats.resumedHandshakes : stats.fullHandshakes);
+		haveSession = mbedtls_ssl_get_session(&ssl, &session) == 0;
+		timing.total = millis() - start;
+		const uint32_t heapAfter = ESP.getFreeHeap();
+		timing.heapUsed = heapBefore > heapAfter ? heapBefore - heapAfter : 0;
+		established = true;
+		return 1;
+	}
+
+	bool configure()
+	{
+		if (configured)
+		{
+			return true;
+		}
+
+		mbedtls_entropy_init(&entropy);
+		mbedtls_ctr_drbg_init(&drbg);
+		mbedtls_x509_crt_init(&ca);
+		mbedtls_ssl_config_init(&conf);
+		mbedtls_ssl_init(&ssl);
+		mbedtls_ssl_session_init(&session);
+		configured = true;
+
+		int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, (const unsigned char*)"cyd-mqtt", 8);
+		if (ret == 0)
+		{
+			ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+		}
+		if (ret == 0)
+		{
+			mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+#if MBEDTLS_VERSION_MAJOR >= 3
+			// TLS 1.3 resumption works differently; stay on 1.2 where tickets and IDs are cached the same way
+			mbedtls_ssl_conf_max_tls_version(&conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#else
+			mbedtls_ssl_conf_max_version(&conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+#endif
+			mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+			if (pskIdentity)
+			{
+				ret = mbedtls_ssl_conf_psk(&conf, pskKey, pskKeyLength, (const unsigned char*)pskIdentity, strlen(pskIdentity));
+				mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+			}
+			else if (caCertificate)
+			{
+				ret = mbedtls_x509_crt_parse(&ca, (const unsigned char*)caCertificate, strlen(caCertificate) + 1);
+				mbedtls_ssl_conf_ca_chain(&conf, &ca, nullptr);
+				mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+			}
+		}
+		if (ret == 0)
+		{
+			ret = mbedtls_ssl_setup(&ssl, &conf);
+		}
+
+		if (ret != 0)
+		{
+			++stats.failures;
+			stats.lastError = ret;
+			return false;
+		}
+		return true;
+	}
+
+	void fail(int error)
+	{
+		++stats.failures;
+		stats.lastError = error;
+		established = false;
+		inner.stop();
+	}
+
+	int handshakeState() const
+	{
+#if MBEDTLS_VERSION_MAJOR >= 3
+		return ssl.MBEDTLS_PRIVATE(state);
+#else
+		return ssl.state;
+#endif
+	}
+
+	static Phase phaseOf(int state)
+	{
+		if (state <= MBEDTLS_SSL_SERVER_HELLO)
+		{
+			return Hello;
+		}
+		if (state <= MBEDTLS_SSL_SERVER_HELLO_DONE)
+		{
+			return ServerAuth;
+		}
+		if (state <= MBEDTLS_SSL_CERTIFICATE_VERIFY)
+		{
+			return KeyExchange;
+		}
+		return Finish;
+	}
+
+	uint32_t& phaseTime(Phase phase)
+	{
+		switch (phase)
+		{
+		case Hello:
+			return timing.hello;
+		case ServerAuth:
+			return timing.serverAuth;
+		case KeyExchange:
+			return timing.keyExchange;
+		default:
+			return timing.finish;
+		}
+	}
+
+	static int send(void* context, const unsigned char* data, size_t length)
+	{
+		Client& client = static_cast<TlsClient*>(context)->inner;
+		if (!client.connected())
+		{
+			return MBEDTLS_ERR_NET_CONN_RESET;
+		}
+		size_t n = client.write(data, length);
+		return n > 0 ? (int)n : MBEDTLS_ERR_SSL_WANT_WRITE;
+	}
+
+	static int receive(void* context, unsigned char* data, size_t length)
+	{
+		Client& client = static_cast<TlsClient*>(context)->inner;
+		if (client.available() <= 0)
+		{
+			return client.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+		}
+		int n = client.read(data, length);
+		return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+	}
+};
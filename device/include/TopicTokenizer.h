@@ -0,0 +1,190 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Start and length of each '/'-separated level of a topic, found without copying or
+// allocating and several bytes per step (SSE2/NEON on the host, a machine word elsewhere).
+namespace TopicTokenizer
+{
+	struct Levels
+	{
+		static constexpr size_t Capacity = 16;
+
+		const char* text;
+		uint16_t start[Capacity];
+		uint16_t length[Capacity];
+		uint8_t count;
+		bool truncated; // Deeper than Capacity; only a pattern ending in '#' within Capacity levels can match
+
+		bool equals(size_t level, const std::string& value) const
+		{
+			return length[level] == value.size() && memcmp(text + start[level], value.data(), value.size()) == 0;
+		}
+	};
+
+	// Collects levels as separators are found
+	class Builder
+	{
+	public:
+		Builder(Levels& levels, const char* text) : levels(levels)
+		{
+			levels.text = text;
+			levels.count = 0;
+			levels.truncated = false;
+		}
+
+		// A level ends at `at` (a separator or the end of the topic). False once full.
+		bool end(size_t at)
+		{
+			if (levels.count == Levels::Capacity)
+			{
+				levels.truncated = true;
+				return false;
+			}
+			levels.start[levels.count] = (uint16_t)start;
+			levels.length[levels.count] = (uint16_t)(at - start);
+			++levels.count;
+			start = at + 1;
+			return true;
+		}
+
+		// Checks [from, to) one byte at a time
+		bool bytes(const char* text, size_t from, size_t to)
+		{
+			for (size_t i = from; i < to; ++i)
+			{
+				if (text[i] == '/' && !end(i))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// A bit mask of separators found at `base`, `stride` bits per byte
+		template <typename Mask>
+		bool mask(Mask hits, size_t base, unsigned stride)
+		{
+			while (hits)
+			{
+				const unsigned bit = sizeof(Mask) > 4 ? (unsigned)__builtin_ctzll((unsigned long long)hits) : (unsigned)__builtin_ctz((unsigned)hits);
+				if (!end(base + bit / stride))
+				{
+					return false;
+				}
+				hits &= ~(Mask)((((Mask)1 << stride) - 1) << (bit - bit % stride));
+			}
+			return true;
+		}
+
+	private:
+		Levels& levels;
+		size_t start = 0;
+	};
+
+	// The reference scan, one byte per step
+	inline Levels bytewise(const char* text, size_t size)
+	{
+		Levels levels;
+		Builder builder(levels, text);
+		if (builder.bytes(text, 0, size))
+		{
+			builder.end(size);
+		}
+		return levels;
+	}
+
+	// One machine word per step: 4 bytes on the ESP32, 8 on a 64-bit host
+	inline Levels wordwise(const char* text, size_t size)
+	{
+		Levels levels;
+		Builder builder(levels, text);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		using Word = uintptr_t;
+		constexpr Word ones = (Word)-1 / 0xff;   // 0x0101...
+		constexpr Word low7 = ones * 0x7f;       // 0x7f7f...
+		constexpr Word slashes = ones * '/';
+
+		size_t i = (size_t)(-(uintptr_t)text & (sizeof(Word) - 1)); // Bytes before the first aligned word; Xtensa has no unaligned loads
+		i = i < size ? i : size;
+		if (!builder.bytes(text, 0, i))
+		{
+			return levels;
+		}
+		for (; i + sizeof(Word) <= size; i += sizeof(Word))
+		{
+			Word word;
+			memcpy(&word, __builtin_assume_aligned(text + i, sizeof(Word)), sizeof(Word));
+			const Word x = word ^ slashes;
+			// 0x80 in each byte of x that is zero, with no borrow between bytes
+			const Word hits = ~(((x & low7) + low7) | x | low7);
+			if (hits && !builder.mask(hits, i, 8))
+			{
+				return levels;
+			}
+		}
+#else
+		size_t i = 0;
+#endif
+		if (builder.bytes(text, i, size))
+		{
+			builder.end(size);
+		}
+		return levels;
+	}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+	// 16 bytes per step with the host's vector unit
+	inline Levels vectorwise(const char* text, size_t size)
+	{
+		Levels levels;
+		Builder builder(levels, text);
+		size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+#if defined(__SSE2__)
+			const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+			const uint32_t hits = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('/')));
+			if (hits && !builder.mask(hits, i, 1))
+			{
+				return levels;
+			}
+#else
+			// NEON has no movemask; narrowing the compare result gives 4 bits per byte
+			const uint8x16_t equal = vceqq_u8(vld1q_u8((const uint8_t*)text + i), vdupq_n_u8('/'));
+			const uint64_t hits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+			if (hits && !builder.mask(hits, i, 4))
+			{
+				return levels;
+			}
+#endif
+		}
+		if (builder.bytes(text, i, size))
+		{
+			builder.end(size);
+		}
+		return levels;
+	}
+#endif
+
+	inline Levels tokenize(const char* text, size_t size)
+	{
+#if defined(__SSE2__) || defined(__ARM_NEON)
+		return vectorwise(text, size);
+#else
+		return wordwise(text, size);
+#endif
+	}
+
+	inline Levels tokenize(const std::string& topic)
+	{
+		return tokenize(topic.data(), topic.size());
+	}
+}
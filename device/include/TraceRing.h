@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if !defined(__XTENSA__)
+#include <chrono>
+#endif
+
+// Begin/end events of the main loop's phases in a fixed ring, for trace_to_chrome.cpp.
+// Only with -D CYD_TRACE; otherwise the TRACE_ macros expand to nothing.
+namespace Trace
+{
+	enum Point : uint8_t
+	{
+		Loop,
+		RenderSensors,
+		LvTimer,
+		Flush,
+		MqttLoop,
+		Dispatch,
+		Handler,
+		PublishFlush,
+		PointCount,
+	};
+
+	inline const char* name(uint8_t point)
+	{
+		static const char* const names[PointCount] = {"loop", "render_dirty_sensors", "lv_timer_handler", "display_flush",
+		                                              "client.loop", "MQTTDispatcher::dispatch", "handler", "publishQueue.flush"};
+		return point < PointCount ? names[point] : "?";
+	}
+
+	// CPU cycles on the ESP32 (wraps every ~18 s at 240 MHz), nanoseconds on a host
+	inline uint32_t ticks()
+	{
+#if defined(__XTENSA__)
+		uint32_t ccount;
+		__asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+		return ccount;
+#else
+		return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	struct Event
+	{
+		uint32_t ticks;
+		uint8_t point;
+		uint8_t phase; // 'B' or 'E'
+		uint16_t arg;  // Handler index for Handler, 0 otherwise
+	};
+
+	// Dump layout, little-endian: this header, then count Events oldest first
+	struct DumpHeader
+	{
+		char magic[4]; // "CYDT"
+		uint8_t version;
+		uint8_t eventSize;
+		uint16_t reserved;
+		uint32_t ticksPerUs;
+		uint32_t count;
+	};
+
+	template <size_t Capacity>
+	class Ring
+	{
+	public:
+		void record(uint8_t point, uint8_t phase, uint16_t arg = 0)
+		{
+			if (frozen)
+			{
+				return;
+			}
+			events[head] = {ticks(), point, phase, arg};
+			head = (head + 1) % Capacity;
+			count += count < Capacity;
+		}
+
+		size_t dumpSize() const
+		{
+			return sizeof(DumpHeader) + count * sizeof(Event);
+		}
+
+		// Calls write(const uint8_t*, size_t) with the header and the events, oldest first.
+		// Recording pauses meanwhile, so what goes out is one consistent window.
+		template <typename Write>
+		void dump(uint32_t ticksPerUs, Write write)
+		{
+			frozen = true;
+			DumpHeader header = {{'C', 'Y', 'D', 'T'}, 1, (uint8_t)sizeof(Event), 0, ticksPerUs, (uint32_t)count};
+			write((const uint8_t*)&header, sizeof(header));
+			const size_t oldest = (head + Capacity - count) % Capacity;
+			const size_t first = count < Capacity - oldest ? count : Capacity - oldest;
+			write((const uint8_t*)&events[oldest], first * sizeof(Event));
+			write((const uint8_t*)&events[0], (count - first) * sizeof(Event));
+			frozen = false;
+		}
+
+	private:
+		Event events[Capacity];
+		size_t head = 0;
+		size_t count = 0;
+		bool frozen = false;
+	};
+
+	template <typename R>
+	class Scope
+	{
+	public:
+		Scope(R& ring, uint8_t point, uint16_t arg = 0) : ring(ring), point(point), arg(arg)
+		{
+			ring.record(point, 'B', arg);
+		}
+
+		~Scope()
+		{
+			ring.record(point, 'E', arg);
+		}
+
+	private:
+		R& ring;
+		uint8_t point;
+		uint16_t arg;
+	};
+}
+
+#ifdef CYD_TRACE
+#ifndef CYD_TRACE_EVENTS
+#define CYD_TRACE_EVENTS 1024 // 8 KB, a few hundred loop passes
+#endif
+using TraceRing = Trace::Ring<CYD_TRACE_EVENTS>;
+extern TraceRing traceRing; // Defined by the application
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(point) Trace::Scope<TraceRing> TRACE_CONCAT(traceScope, __LINE__)(traceRing, Trace::point)
+#define TRACE_SCOPE_ARG(point, arg) Trace::Scope<TraceRing> TRACE_CONCAT(traceScope, __LINE__)(traceRing, Trace::point, (uint16_t)(arg))
+#else
+#define TRACE_SCOPE(point)
+#define TRACE_SCOPE_ARG(point, arg)
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Byte stream the MQTT client runs over. Implementations: ClientTransport
+// (WiFiClient or TlsClient on the device), PosixTransport (TCP sockets on a
+// host) and LoopbackTransport (in memory, paired with FakeBroker in tests).
+// Nothing here blocks except open(), and send() on a full socket buffer, for a
+// bounded time (PosixTransport::SendTimeoutMs).
+class Transport
+{
+public:
+	virtual ~Transport() = default;
+
+	virtual bool open(const char* host, uint16_t port) = 0;
+	virtual void close() = 0;
+	virtual bool isOpen() = 0;
+
+	// Bytes accepted, possibly fewer than length; 0 when the stream is closed
+	virtual size_t send(const uint8_t* data, size_t length) = 0;
+
+	// Bytes read, 0 when nothing is waiting, -1 once the stream is closed
+	virtual int receive(uint8_t* data, size_t length) = 0;
+
+	// Bytes that receive() can return right now
+	virtual size_t pending() = 0;
+};
@@ -45,14 +45,20 @@
  * - LV_STDLIB_RTTHREAD:    RT-Thread implementation
  * - LV_STDLIB_CUSTOM:      Implement the functions externally
  */
+#ifdef CYD_NO_HEAP_AFTER_BOOT
+/*No-heap-after-boot mode: LVGL allocates from its own static pool, never from malloc.
+ *src/AllocTracking.cpp still counts the pool's allocations (lv_malloc_core is wrapped)*/
+#define LV_USE_STDLIB_MALLOC    LV_STDLIB_BUILTIN
+#else
 #define LV_USE_STDLIB_MALLOC    LV_STDLIB_CLIB
+#endif
 #define LV_USE_STDLIB_STRING    LV_STDLIB_CLIB
 #define LV_USE_STDLIB_SPRINTF   LV_STDLIB_CLIB
 
 
 #if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
     /*Size of the memory available for `lv_malloc()` in bytes (>= 2kB)*/
-    #define LV_MEM_SIZE (32 * 1024U)          /*[bytes]*/
+    #define LV_MEM_SIZE (48 * 1024U)          /*[bytes]*/
 
     /*Size of the memory expand for `lv_malloc()` in bytes*/
     #define LV_MEM_POOL_EXPAND_SIZE 0
@@ -902,8 +908,12 @@
 /*Driver for /dev/dri/card*/
 #define LV_USE_LINUX_DRM        0
 
-/*Interface for TFT_eSPI*/
+/*Interface for TFT_eSPI (not under env:native, which flushes through the HAL)*/
+#ifdef CYD_NATIVE
+#define LV_USE_TFT_ESPI         0
+#else
 #define LV_USE_TFT_ESPI         1
+#endif
 
 /*Driver for evdev input devices*/
 #define LV_USE_EVDEV    0
@@ -7,3 +7,10 @@
 #define MQTT_PASSWORD "Your MQTT Password"
 #define MQTT_BROKER_IP "Your MQTT Broker IP"
 #define MDNS_HOSTNAME "Your mDNS Hostname"
+
+// Optional MQTT over TLS. Define either a CA certificate or a PSK identity/key pair.
+// The port defaults to utils/mosquitto's listeners (8883 certificate, 8884 PSK).
+//#define MQTT_TLS_PORT 8883
+//#define MQTT_TLS_CA_CERT "-----BEGIN CERTIFICATE-----\n...\n-----END CERTIFICATE-----\n"
+//#define MQTT_TLS_PSK_IDENTITY "cyd"
+//#define MQTT_TLS_PSK_KEY "hex key from utils/mosquitto/config/psk.txt"
@@ -0,0 +1,335 @@
+// Host stand-in for the Arduino core, just enough of it for main.cpp,
+// PubSubClient and ArduinoJson to build under env:native. Timing goes through
+// the HAL; hardware-only calls are no-ops.
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "Hal.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_byte_near(address) pgm_read_byte(address)
+
+inline unsigned long millis() { return hal::millis(); }
+inline unsigned long micros() { return hal::micros(); }
+inline void delay(unsigned long ms) { hal::delay(ms); }
+inline void yield() {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+class String
+{
+public:
+  String() = default;
+  String(const char *value) : text(value ? value : "") {}
+  String(const std::string &value) : text(value) {}
+  String(char value) : text(1, value) {}
+  String(int value, unsigned char base = DEC) : text(format((long long)value, base)) {}
+  String(unsigned value, unsigned char base = DEC) : text(format((unsigned long long)value, base)) {}
+  String(long value, unsigned char base = DEC) : text(format((long long)value, base)) {}
+  String(unsigned long value, unsigned char base = DEC) : text(format((unsigned long long)value, base)) {}
+  String(long long value, unsigned char base = DEC) : text(format(value, base)) {}
+  String(unsigned long long value, unsigned char base = DEC) : text(format(value, base)) {}
+  String(float value, unsigned char decimals = 2) : text(format((double)value, decimals)) {}
+  String(double value, unsigned char decimals = 2) : text(format(value, decimals)) {}
+
+  const char *c_str() const { return text.c_str(); }
+  unsigned int length() const { return (unsigned int)text.size(); }
+  bool isEmpty() const { return text.empty(); }
+  char operator[](unsigned int index) const { return index < text.size() ? text[index] : '\0'; }
+  char charAt(unsigned int index) const { return (*this)[index]; }
+
+  bool concat(const char *value) { text += value ? value : ""; return true; }
+  bool concat(const String &value) { text += value.text; return true; }
+  bool concat(char value) { text += value; return true; }
+  String &operator+=(const String &value) { text += value.text; return *this; }
+  String &operator+=(const char *value) { text += value ? value : ""; return *this; }
+  String &operator+=(char value) { text += value; return *this; }
+
+  bool operator==(const String &other) const { return text == other.text; }
+  bool operator==(const char *other) const { return text == (other ? other : ""); }
+  bool operator!=(const String &other) const { return text != other.text; }
+  bool operator!=(const char *other) const { return !(*this == other); }
+  bool operator<(const String &other) const { return text < other.text; }
+
+  int indexOf(char value, unsigned int from = 0) const
+  {
+    size_t at = text.find(value, from);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+
+  int indexOf(const char *value, unsigned int from = 0) const
+  {
+    size_t at = text.find(value, from);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+
+  String substring(unsigned int from, unsigned int to = ~0u) const
+  {
+    if (from >= text.size())
+    {
+      return String();
+    }
+    return String(text.substr(from, std::min<size_t>(to, text.size()) - from));
+  }
+
+  void replace(const String &find, const String &replacement)
+  {
+    if (find.text.empty())
+    {
+      return;
+    }
+    for (size_t at = text.find(find.text); at != std::string::npos; at = text.find(find.text, at + replacement.text.size()))
+    {
+      text.replace(at, find.text.size(), replacement.text);
+    }
+  }
+
+  void toLowerCase()
+  {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+  }
+
+  void toUpperCase()
+  {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)toupper(c); });
+  }
+
+  void trim()
+  {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    size_t end = text.find_last_not_of(" \t\r\n");
+    text = start == std::string::npos ? std::string() : text.substr(start, end - start + 1);
+  }
+
+  long toInt() const { return strtol(text.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(text.c_str(), nullptr); }
+
+  // ArduinoJson's String writer
+  void reserve(unsigned int size) { text.reserve(size); }
+
+private:
+  std::string text;
+
+  static std::string format(long long value, unsigned char base)
+  {
+    return value < 0 ? "-" + format((unsigned long long)-value, base) : format((unsigned long long)value, base);
+  }
+
+  static std::string format(unsigned long long value, unsigned char base)
+  {
+    char digits[65];
+    size_t at = sizeof(digits);
+    do
+    {
+      digits[--at] = "0123456789abcdef"[value % base];
+      value /= base;
+    } while (value > 0 && at > 0);
+    return std::string(digits + at, sizeof(digits) - at);
+  }
+
+  static std::string format(double value, unsigned char decimals)
+  {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    return buffer;
+  }
+};
+
+// ArduinoJson recognises the result of String concatenation by this name
+class StringSumHelper : public String
+{
+public:
+  using String::String;
+  StringSumHelper(const String &value) : String(value) {}
+};
+
+inline StringSumHelper operator+(const String &left, const String &right)
+{
+  StringSumHelper sum(left);
+  sum += right;
+  return sum;
+}
+
+inline StringSumHelper operator+(const String &left, const char *right)
+{
+  StringSumHelper sum(left);
+  sum += right;
+  return sum;
+}
+
+inline StringSumHelper operator+(const char *left, const String &right)
+{
+  StringSumHelper sum(left);
+  sum += right;
+  return sum;
+}
+
+template <typename Number, typename = typename std::enable_if<std::is_arithmetic<Number>::value>::type>
+inline StringSumHelper operator+(const String &left, Number right)
+{
+  StringSumHelper sum(left);
+  sum += String(right);
+  return sum;
+}
+
+class Print
+{
+public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t value) = 0;
+
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t written = 0;
+    while (written < size && write(buffer[written]))
+    {
+      ++written;
+    }
+    return written;
+  }
+
+  size_t write(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+  size_t print(const char *text) { return write(text); }
+  size_t print(const String &text) { return write(text.c_str()); }
+  size_t print(char value) { return write((uint8_t)value); }
+  size_t print(long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(int value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, (unsigned char)decimals)); }
+  size_t println() { return write("\n"); }
+
+  template <typename T>
+  size_t println(const T &value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return n > 0 ? write((const uint8_t *)buffer, std::min((size_t)n, sizeof(buffer) - 1)) : 0;
+  }
+
+  virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long ms) { timeout = ms; }
+
+  size_t readBytes(uint8_t *buffer, size_t length)
+  {
+    size_t count = 0;
+    unsigned long start = millis();
+    while (count < length && millis() - start < timeout)
+    {
+      int c = read();
+      if (c >= 0)
+      {
+        buffer[count++] = (uint8_t)c;
+      }
+    }
+    return count;
+  }
+
+protected:
+  unsigned long timeout = 1000;
+};
+
+// Serial output goes to stdout
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t value) override { return fputc(value, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override { fflush(stdout); }
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress
+{
+public:
+  IPAddress() = default;
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+  IPAddress(const uint8_t *address) { memcpy(octets, address, 4); }
+
+  uint8_t operator[](int index) const { return octets[index]; }
+  uint8_t &operator[](int index) { return octets[index]; }
+  bool operator==(const IPAddress &other) const { return memcmp(octets, other.octets, 4) == 0; }
+
+  bool fromString(const char *text)
+  {
+    unsigned a, b, c, d;
+    if (sscanf(text, "%u.%u.%u.%u", &a, &b, &c, &d) != 4)
+    {
+      return false;
+    }
+    *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+    return true;
+  }
+
+  String toString() const
+  {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+    return text;
+  }
+
+private:
+  uint8_t octets[4] = {};
+};
+
+// Chip queries printed at boot and used by the heap metrics
+class EspClass
+{
+public:
+  uint64_t getEfuseMac() const { return 0x0000A1B2C3D4E5F6ull; }
+  const char *getChipModel() const { return "native"; }
+  uint8_t getChipRevision() const { return 0; }
+  uint32_t getFlashChipSize() const { return 4 * 1024 * 1024; }
+  uint32_t getHeapSize() const { return 320 * 1024; }
+  uint32_t getFreeHeap() const { return 200 * 1024; }
+  uint32_t getMinFreeHeap() const { return 200 * 1024; }
+  uint32_t getMaxAllocHeap() const { return 110 * 1024; }
+  void restart() { exit(0); }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,61 @@
+// Host file system: LittleFS paths map into a directory (CYD_FLASH_DIR,
+// default ./.cyd-flash), so the sensor log persists between native runs.
+#pragma once
+#include <cerrno>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Arduino.h"
+
+class File
+{
+public:
+  File() = default;
+  explicit File(FILE *file) : file(file, [](FILE *f) { fclose(f); }) {}
+
+  explicit operator bool() const { return file != nullptr; }
+  bool seek(uint32_t position) { return file && fseek(file.get(), position, SEEK_SET) == 0; }
+  size_t read(uint8_t *buffer, size_t size) { return file ? fread(buffer, 1, size, file.get()) : 0; }
+  size_t write(const uint8_t *buffer, size_t size) { return file ? fwrite(buffer, 1, size, file.get()) : 0; }
+  size_t size() const
+  {
+    struct stat info;
+    return file && fstat(fileno(file.get()), &info) == 0 ? (size_t)info.st_size : 0;
+  }
+  void close() { file.reset(); }
+
+private:
+  std::shared_ptr<FILE> file;
+};
+
+class FS
+{
+public:
+  bool begin(bool formatOnFail = false)
+  {
+    (void)formatOnFail;
+    const char *dir = getenv("CYD_FLASH_DIR");
+    root = dir ? dir : ".cyd-flash";
+    ::mkdir(root.c_str(), 0755);
+    return true;
+  }
+
+  File open(const char *path, const char *mode)
+  {
+    std::string fopenMode = strcmp(mode, "r+") == 0 ? "r+b" : strcmp(mode, "w") == 0 ? "w+b" : strcmp(mode, "a") == 0 ? "ab" : "rb";
+    FILE *file = fopen(resolve(path).c_str(), fopenMode.c_str());
+    return file ? File(file) : File();
+  }
+
+  bool exists(const char *path) { return access(resolve(path).c_str(), F_OK) == 0; }
+  bool remove(const char *path) { return ::remove(resolve(path).c_str()) == 0; }
+  bool mkdir(const char *path) { return ::mkdir(resolve(path).c_str(), 0755) == 0 || errno == EEXIST; }
+
+private:
+  std::string root = ".cyd-flash";
+
+  std::string resolve(const char *path) const
+  {
+    return root + (path[0] == '/' ? "" : "/") + path;
+  }
+};
@@ -0,0 +1,103 @@
+// Host HTTPClient: the blocking HTTP/1.0 request/response the provisioning
+// exchange needs, over WiFiClient.
+#pragma once
+#include "WiFi.h"
+
+#define HTTP_CODE_OK 200
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient
+{
+public:
+  bool begin(const String &url)
+  {
+    // http://host:port/path
+    String rest = url.substring(url.indexOf("://") + 3);
+    int slash = rest.indexOf('/');
+    String authority = slash < 0 ? rest : rest.substring(0, slash);
+    path = slash < 0 ? String("/") : rest.substring(slash);
+    int colon = authority.indexOf(':');
+    host = colon < 0 ? authority : authority.substring(0, colon);
+    port = colon < 0 ? 80 : (uint16_t)authority.substring(colon + 1).toInt();
+    headers = "";
+    return true;
+  }
+
+  void addHeader(const String &name, const String &value)
+  {
+    headers += name + ": " + value + "\r\n";
+  }
+
+  void setTimeout(uint16_t ms)
+  {
+    timeoutMs = ms;
+  }
+
+  int POST(const String &body)
+  {
+    return POST((uint8_t *)body.c_str(), body.length());
+  }
+
+  int POST(uint8_t *payload, size_t size)
+  {
+    response = "";
+    if (!client.connect(host.c_str(), port))
+    {
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    String request = "POST " + path + " HTTP/1.0\r\nHost: " + host + "\r\n" + headers +
+                     "Content-Length: " + String((unsigned)size) + "\r\n\r\n";
+    client.write((const uint8_t *)request.c_str(), request.length());
+    client.write(payload, size);
+
+    // HTTP/1.0: the server closes the connection after the response
+    String raw;
+    unsigned long start = millis();
+    while (millis() - start < timeoutMs)
+    {
+      uint8_t buffer[512];
+      int n = client.read(buffer, sizeof(buffer));
+      if (n > 0)
+      {
+        raw += String(std::string((const char *)buffer, n));
+      }
+      else if (!client.connected())
+      {
+        break;
+      }
+      else
+      {
+        delay(1);
+      }
+    }
+    client.stop();
+
+    int headerEnd = raw.indexOf("\r\n\r\n");
+    int space = raw.indexOf(' ');
+    if (headerEnd < 0 || space < 0)
+    {
+      return HTTPC_ERROR_READ_TIMEOUT;
+    }
+    response = raw.substring(headerEnd + 4);
+    return (int)raw.substring(space + 1).toInt();
+  }
+
+  String getString() { return response; }
+  void end() { client.stop(); }
+
+  static String errorToString(int code)
+  {
+    return code == HTTPC_ERROR_CONNECTION_REFUSED ? "connection refused" : code == HTTPC_ERROR_READ_TIMEOUT ? "read timeout" : "HTTP error";
+  }
+
+private:
+  WiFiClient client;
+  String host;
+  String path;
+  String headers;
+  String response;
+  uint16_t port = 80;
+  unsigned long timeoutMs = 5000;
+};
@@ -0,0 +1,63 @@
+// Host WiFiClient: a TCP connection through PosixTransport. WiFi itself is
+// always up on the host; its state comes from the HAL.
+#pragma once
+#include "Client.h"
+#include "PosixTransport.h"
+
+class WiFiClient : public Client
+{
+public:
+  int connect(IPAddress ip, uint16_t port) override { return connect(ip.toString().c_str(), port); }
+
+  int connect(const char *host, uint16_t port) override
+  {
+    peeked = -1;
+    return transport.open(host, port) ? 1 : 0;
+  }
+
+  size_t write(uint8_t value) override { return transport.send(&value, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override { return transport.send(buffer, size); }
+  int available() override { return (int)transport.pending() + (peeked >= 0 ? 1 : 0); }
+
+  int read() override
+  {
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+  }
+
+  int read(uint8_t *buffer, size_t size) override
+  {
+    if (size == 0)
+    {
+      return 0;
+    }
+    size_t copied = 0;
+    if (peeked >= 0)
+    {
+      buffer[copied++] = (uint8_t)peeked;
+      peeked = -1;
+    }
+    int n = copied < size ? transport.receive(buffer + copied, size - copied) : 0;
+    copied += n > 0 ? n : 0;
+    return copied > 0 ? (int)copied : -1;
+  }
+
+  int peek() override
+  {
+    if (peeked < 0)
+    {
+      uint8_t value;
+      peeked = transport.receive(&value, 1) == 1 ? value : -1;
+    }
+    return peeked;
+  }
+
+  void flush() override {}
+  void stop() override { transport.close(); }
+  uint8_t connected() override { return transport.isOpen() || available() > 0; }
+  operator bool() override { return transport.isOpen(); }
+
+private:
+  PosixTransport transport;
+  int peeked = -1;
+};
@@ -0,0 +1,23 @@
+// Arduino runtime for env:native: the globals the core would define and the
+// setup()/loop() driver (env:native_replay has its own, in replay_native.cpp).
+#include <Arduino.h>
+#include <LittleFS.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+FS LittleFS;
+
+void setup();
+void loop();
+
+#ifndef CYD_REPLAY
+int main()
+{
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  setup();
+  for (;;)
+  {
+    loop();
+  }
+}
+#endif
@@ -0,0 +1,179 @@
+// Board services on a Linux host; see include/Hal.h. Configured through the environment:
+//   CYD_PROVISION   host:port answered for the cyd-provision mDNS query
+//   CYD_NVS_DIR     directory holding NVS keys (default ./.cyd-nvs)
+//   CYD_FRAMEBUFFER PPM file the screen is written to after each changed frame
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+#include "Hal.h"
+
+static const uint32_t screenWidth = 320;
+static const uint32_t screenHeight = 240;
+
+static std::vector<uint16_t> framebuffer(screenWidth * screenHeight);
+static bool framebufferDirty = false;
+static uint32_t lastFramebufferWrite = 0;
+
+static std::string nvsPath(const char *space, const char *key)
+{
+  const char *dir = getenv("CYD_NVS_DIR");
+  std::string root = dir ? dir : ".cyd-nvs";
+  mkdir(root.c_str(), 0755);
+  return root + "/" + space + "." + key;
+}
+
+// RGB565 to binary PPM, at most once per second
+static void writeFramebuffer()
+{
+  const char *path = getenv("CYD_FRAMEBUFFER");
+  if (!path || !framebufferDirty || hal::millis() - lastFramebufferWrite < 1000)
+  {
+    return;
+  }
+  FILE *file = fopen(path, "wb");
+  if (!file)
+  {
+    return;
+  }
+  fprintf(file, "P6\n%u %u\n255\n", screenWidth, screenHeight);
+  for (uint16_t pixel : framebuffer)
+  {
+    const uint8_t rgb[3] = {(uint8_t)((pixel >> 11) << 3), (uint8_t)(((pixel >> 5) & 0x3F) << 2), (uint8_t)((pixel & 0x1F) << 3)};
+    fwrite(rgb, 1, sizeof(rgb), file);
+  }
+  fclose(file);
+  framebufferDirty = false;
+  lastFramebufferWrite = hal::millis();
+}
+
+namespace hal
+{
+  uint32_t millis()
+  {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  uint32_t micros()
+  {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void delay(uint32_t ms)
+  {
+    writeFramebuffer();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+
+  void startTimeSync(const char *)
+  {
+    // The host clock is already synchronised
+  }
+
+  void wifiBegin(const char *, const char *)
+  {
+  }
+
+  bool wifiConnected()
+  {
+    return true;
+  }
+
+  std::string wifiAddress()
+  {
+    return "127.0.0.1";
+  }
+
+  std::string macAddress()
+  {
+    return "A1:B2:C3:D4:E5:F6";
+  }
+
+  int wifiRssi()
+  {
+    return -50;
+  }
+
+  bool mdnsBegin(const char *)
+  {
+    return true;
+  }
+
+  bool mdnsFind(const char *service, const char *, std::string &host, uint16_t &port)
+  {
+    const char *provision = getenv("CYD_PROVISION");
+    if (strcmp(service, "cyd-provision") != 0 || !provision || !strchr(provision, ':'))
+    {
+      return false;
+    }
+    const char *colon = strrchr(provision, ':');
+    host.assign(provision, colon - provision);
+    port = (uint16_t)atoi(colon + 1);
+    return true;
+  }
+
+  size_t nvsRead(const char *space, const char *key, void *data, size_t length)
+  {
+    FILE *file = fopen(nvsPath(space, key).c_str(), "rb");
+    if (!file)
+    {
+      return 0;
+    }
+    size_t read = fread(data, 1, length, file);
+    bool exact = read == length && fgetc(file) == EOF;
+    fclose(file);
+    return exact ? read : 0;
+  }
+
+  bool nvsWrite(const char *space, const char *key, const void *data, size_t length)
+  {
+    FILE *file = fopen(nvsPath(space, key).c_str(), "wb");
+    if (!file)
+    {
+      return false;
+    }
+    bool written = fwrite(data, 1, length, file) == length;
+    fclose(file);
+    return written;
+  }
+
+  int32_t stackHighWater(const char *)
+  {
+    return -1; // No FreeRTOS tasks on the host
+  }
+
+  bool onMainTask()
+  {
+    static const std::thread::id mainThread = std::this_thread::get_id();
+    return std::this_thread::get_id() == mainThread;
+  }
+
+  void displayBegin()
+  {
+  }
+
+  void displayFlush(int32_t x, int32_t y, uint32_t width, uint32_t height, const uint16_t *pixels)
+  {
+    for (uint32_t row = 0; row < height; ++row)
+    {
+      if (y + row >= screenHeight || x >= (int32_t)screenWidth)
+      {
+        break;
+      }
+      const uint32_t columns = std::min(width, screenWidth - x);
+      memcpy(&framebuffer[(y + row) * screenWidth + x], pixels + row * width, columns * sizeof(uint16_t));
+    }
+    framebufferDirty = true;
+  }
+
+  void backlight(bool)
+  {
+  }
+}
@@ -0,0 +1,208 @@
+// Replays a capture (utils/bench/mqtt_capture.cpp) through main.cpp itself for env:native_replay:
+// setup() as on the device, then each message into mqtt_callback, or in StreamingClient-sized
+// pieces into mqtt_chunk_callback when the packet would not fit PubSubClient's buffer. Reports
+// throughput, per-message latency and the AllocTracker counts per message, by scope. Then checks,
+// on a route of its own added after the measurement, that the chunk path strips send stamps.
+// Run: .pio/build/native_replay/program ha.cap [speed, 0 = as fast as possible] [passes]
+#ifdef CYD_REPLAY
+#ifndef CYD_ALLOC_TRACK
+#error "env:native_replay counts allocations with AllocTracker: build with -D CYD_ALLOC_TRACK and the allocator wrapped"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include "AlertEngine.h"
+#include "AllocTracker.h"
+#include "MQTTDispatcher.h"
+#include "MqttCapture.h"
+#include "SendStamp.h"
+#include "SensorRegistry.h"
+#include "StreamingClient.h"
+
+using Clock = std::chrono::steady_clock;
+
+// main.cpp
+extern PubSubClient client;
+extern MQTTDispatcher mqttDispatcher;
+extern SensorRegistry sensorRegistry;
+extern AlertEngine alertEngine;
+void setup();
+void mqtt_callback(char *topic, byte *payload, unsigned int length);
+void mqtt_chunk_callback(const std::string &topic, const uint8_t *data, size_t length, size_t offset, size_t total);
+
+// Size of the PUBLISH packet PubSubClient would have to buffer, as StreamingClient computes it
+static size_t packetSize(const MqttCapture::Message &message)
+{
+  const size_t remaining = 2 + message.topic->size() + message.length;
+  size_t header = 2;
+  for (size_t rest = remaining >> 7; rest; rest >>= 7)
+  {
+    ++header;
+  }
+  return header + remaining;
+}
+
+// Returns whether the message took the chunk path
+static bool deliver(const MqttCapture::Message &message)
+{
+  if (packetSize(message) < client.getBufferSize())
+  {
+    mqtt_callback((char *)message.topic->c_str(), (byte *)message.payload, (unsigned int)message.length);
+    return false;
+  }
+  size_t offset = 0;
+  do
+  {
+    const size_t length = std::min(StreamingClient::ChunkSize, message.length - offset);
+    mqtt_chunk_callback(*message.topic, message.payload + offset, length, offset, message.length);
+    offset += length;
+  } while (offset < message.length);
+  return true;
+}
+
+// Main task allocations so far; other_tasks is left out, the replay runs on one thread
+static uint32_t allocations(AllocTracker::Scope scope)
+{
+  return scope == AllocTracker::OtherTasks ? 0 : AllocTracker::totals(scope).count;
+}
+
+static uint32_t allocations()
+{
+  uint32_t count = 0;
+  for (uint8_t scope = 0; scope < AllocTracker::ScopeCount; ++scope)
+  {
+    count += allocations((AllocTracker::Scope)scope);
+  }
+  return count;
+}
+
+// mqtt_loadgen stamps every payload, oversized ones included: the handler must get the
+// same bytes whichever path the message took and whether or not it was stamped
+static bool stampedChunksMatch()
+{
+  static const std::string topic = "cyd/replay/stamped";
+  static std::string received;
+  mqttDispatcher.registerHandler(topic, [](const std::string &, const std::string &message) { received = message; });
+  std::string payload = "{\"name\":\"" + std::string(3 * StreamingClient::ChunkSize, 'x') + "\"}";
+  std::string stamped = payload;
+  SendStamp::prepend(stamped, 1760000000123456ULL);
+  for (const std::string *sent : {&payload, &stamped})
+  {
+    received.clear();
+    const MqttCapture::Message message{0, &topic, (const uint8_t *)sent->data(), sent->size(), false};
+    if (!deliver(message) || received != payload)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static double percentile(std::vector<uint32_t> &samples, double p)
+{
+  if (samples.empty())
+  {
+    return 0;
+  }
+  auto at = samples.begin() + (size_t)(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), at, samples.end());
+  return *at;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s capture [speed, 0 = as fast as possible] [passes]\n", argv[0]);
+    return 2;
+  }
+  const double speed = argc >= 3 ? atof(argv[2]) : 0;
+  const int passes = argc >= 4 ? std::max(1, atoi(argv[3])) : 1;
+
+  MqttCapture::Reader capture;
+  if (!capture.load(argv[1]))
+  {
+    fprintf(stderr, "%s is not a capture\n", argv[1]);
+    return 1;
+  }
+  size_t total = 0;
+  uint64_t durationUs = 0;
+  for (MqttCapture::Message message; capture.next(message); ++total)
+  {
+    durationUs = message.timeUs;
+  }
+  fprintf(stderr, "%s: %zu messages on %zu topics over %.1f s\n", argv[1], total, capture.topicCount(), durationUs / 1e6);
+
+  // Serial is stdout; the per-message prints stay in the measurement but not on the terminal
+  if (!freopen("/dev/null", "w", stdout))
+  {
+    return 1;
+  }
+  setup(); // No provisioning service, so no broker: the routes are registered all the same
+  mqttDispatcher.subscriptions(); // As subscribe_all() does, so the per-filter counters start here
+  std::vector<uint32_t> latencyNs;
+  latencyNs.reserve(total * passes);
+  size_t chunked = 0;
+  AllocTracker::reset();
+
+  const auto start = Clock::now();
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    capture.rewind();
+    const auto passStart = Clock::now();
+    for (MqttCapture::Message message; capture.next(message);)
+    {
+      if (speed > 0)
+      {
+        std::this_thread::sleep_until(passStart + std::chrono::microseconds((uint64_t)(message.timeUs / speed)));
+      }
+      const auto before = Clock::now();
+      chunked += deliver(message);
+      latencyNs.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count());
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  const size_t messages = latencyNs.size();
+  const double perMessage = 1.0 / (messages ? messages : 1);
+  double busyNs = 0;
+  for (uint32_t ns : latencyNs)
+  {
+    busyNs += ns;
+  }
+  fprintf(stderr, "replayed %zu messages (%zu through the chunk path) in %.3f s%s\n", messages, chunked, seconds,
+          speed > 0 ? "" : ", as fast as possible");
+  fprintf(stderr, "  %.0f msg/s wall clock, %.0f msg/s in the receive path\n", messages / seconds, messages / (busyNs / 1e9));
+  const double p50 = percentile(latencyNs, 0.50);
+  const double p99 = percentile(latencyNs, 0.99);
+  const double max = messages ? *std::max_element(latencyNs.begin(), latencyNs.end()) : 0;
+  fprintf(stderr, "  latency p50 %.0f ns, p99 %.0f ns, max %.0f ns\n", p50, p99, max);
+  fprintf(stderr, "  %.2f allocations/message:", allocations() * perMessage);
+  for (uint8_t scope = 0; scope < AllocTracker::ScopeCount; ++scope)
+  {
+    if (allocations((AllocTracker::Scope)scope))
+    {
+      fprintf(stderr, " %s %.2f", AllocTracker::name(scope), allocations((AllocTracker::Scope)scope) * perMessage);
+    }
+  }
+  fprintf(stderr, "\n  %zu sensors discovered, %zu alert rules\n", sensorRegistry.size(), alertEngine.size());
+  for (const auto &subscription : mqttDispatcher.subscriptions())
+  {
+    fprintf(stderr, "  %s: received %u, used %u\n", subscription.filter.c_str(), (unsigned)subscription.received,
+            (unsigned)subscription.used);
+  }
+
+  if (!stampedChunksMatch())
+  {
+    fprintf(stderr, "a stamped message on the chunk path reached its handler with the stamp\n");
+    return 1;
+  }
+  return 0;
+}
+#endif
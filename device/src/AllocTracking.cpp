@@ -0,0 +1,245 @@
+// Allocation counters behind include/AllocTracker.h. Only built with -D CYD_ALLOC_TRACK
+// (implied by CYD_NO_HEAP_AFTER_BOOT), which also needs the allocator wrapped at link time:
+//   -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc -Wl,--wrap=free
+// operator new/delete are replaced here and go straight to the real allocator, so
+// each allocation is counted once whichever way it was made. LVGL allocates through
+// malloc (LV_STDLIB_CLIB in lv_conf.h), except in CYD_NO_HEAP_AFTER_BOOT builds, where
+// it has a static pool; those also wrap lv_malloc_core/lv_realloc_core/lv_free_core.
+#include "AllocTracker.h" // May turn on CYD_ALLOC_TRACK for CYD_NO_HEAP_AFTER_BOOT
+#ifdef CYD_ALLOC_TRACK
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "Hal.h"
+
+extern "C"
+{
+  void *__real_malloc(size_t size);
+  void *__real_calloc(size_t count, size_t size);
+  void *__real_realloc(void *pointer, size_t size);
+  void __real_free(void *pointer);
+}
+
+namespace
+{
+  struct Counters
+  {
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> bytes;
+  };
+
+  Counters counters[AllocTracker::ScopeCount];
+  std::atomic<uint32_t> freeCount;
+  // Only the main task moves these
+  AllocTracker::Scope current = AllocTracker::Unscoped;
+  bool sealed = false;
+  bool permitOpen = false;
+  uint32_t violationCount = 0;
+  AllocTracker::Scope violationScope = AllocTracker::Unscoped;
+
+  void tally(size_t size)
+  {
+    const bool main = hal::onMainTask();
+    Counters &c = counters[main ? current : AllocTracker::OtherTasks];
+    c.count.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+
+    if (main && sealed && !permitOpen)
+    {
+      ++violationCount;
+      violationScope = current;
+#if CYD_NO_HEAP_AFTER_BOOT == 2
+      abort();
+#endif
+    }
+  }
+
+  void *allocate(size_t size)
+  {
+    tally(size);
+    void *pointer = __real_malloc(size ? size : 1);
+    if (!pointer)
+    {
+#if __cpp_exceptions
+      throw std::bad_alloc();
+#else
+      abort();
+#endif
+    }
+    return pointer;
+  }
+
+  void release(void *pointer)
+  {
+    if (pointer)
+    {
+      freeCount.fetch_add(1, std::memory_order_relaxed);
+      __real_free(pointer);
+    }
+  }
+}
+
+namespace AllocTracker
+{
+  Scope enter(Scope scope)
+  {
+    Scope previous = current;
+    current = scope;
+    return previous;
+  }
+
+  void leave(Scope previous)
+  {
+    current = previous;
+  }
+
+  Totals totals(Scope scope)
+  {
+    return {counters[scope].count.load(std::memory_order_relaxed), counters[scope].bytes.load(std::memory_order_relaxed)};
+  }
+
+  uint32_t frees()
+  {
+    return freeCount.load(std::memory_order_relaxed);
+  }
+
+  void reset()
+  {
+    for (auto &c : counters)
+    {
+      c.count.store(0, std::memory_order_relaxed);
+      c.bytes.store(0, std::memory_order_relaxed);
+    }
+    freeCount.store(0, std::memory_order_relaxed);
+    violationCount = 0;
+  }
+
+  void seal()
+  {
+#ifdef CYD_NO_HEAP_AFTER_BOOT
+    sealed = true;
+#endif
+  }
+
+  void permit(bool allowed)
+  {
+    permitOpen = allowed;
+  }
+
+  bool permitted()
+  {
+    return permitOpen;
+  }
+
+  uint32_t violations()
+  {
+    return violationCount;
+  }
+
+  Scope lastViolation()
+  {
+    return violationScope;
+  }
+}
+
+extern "C"
+{
+  void *__wrap_malloc(size_t size)
+  {
+    tally(size);
+    return __real_malloc(size);
+  }
+
+  void *__wrap_calloc(size_t count, size_t size)
+  {
+    tally(count * size);
+    return __real_calloc(count, size);
+  }
+
+  // Counted as a new allocation of the full size: a String or buffer that grows a
+  // byte at a time shows up as what it costs the allocator
+  void *__wrap_realloc(void *pointer, size_t size)
+  {
+    tally(size);
+    return __real_realloc(pointer, size);
+  }
+
+  void __wrap_free(void *pointer)
+  {
+    release(pointer);
+  }
+}
+
+#ifdef CYD_NO_HEAP_AFTER_BOOT
+// LVGL's builtin pool (lv_conf.h): never malloc, but counted and guarded the same way
+extern "C"
+{
+  void *__real_lv_malloc_core(size_t size);
+  void *__real_lv_realloc_core(void *pointer, size_t size);
+  void __real_lv_free_core(void *pointer);
+
+  void *__wrap_lv_malloc_core(size_t size)
+  {
+    tally(size);
+    return __real_lv_malloc_core(size);
+  }
+
+  void *__wrap_lv_realloc_core(void *pointer, size_t size)
+  {
+    tally(size);
+    return __real_lv_realloc_core(pointer, size);
+  }
+
+  void __wrap_lv_free_core(void *pointer)
+  {
+    if (pointer)
+    {
+      freeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    __real_lv_free_core(pointer);
+  }
+}
+#endif
+
+void *operator new(size_t size)
+{
+  return allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+  return allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  tally(size);
+  return __real_malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  tally(size);
+  return __real_malloc(size ? size : 1);
+}
+
+void operator delete(void *pointer) noexcept
+{
+  release(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+  release(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+  release(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+  release(pointer);
+}
+#endif
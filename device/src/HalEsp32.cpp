@@ -0,0 +1,140 @@
+// Board services for the ESP32 CYD; see include/Hal.h
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ESPmDNS.h>
+#include <Preferences.h>
+#include <TFT_eSPI.h>
+#include <time.h>
+#include "Hal.h"
+
+#define LCD_BACKLIGHT_PIN 21
+
+static TFT_eSPI tft = TFT_eSPI(); // Uses settings from User_Setup.h
+
+namespace hal
+{
+  uint32_t millis()
+  {
+    return ::millis();
+  }
+
+  uint32_t micros()
+  {
+    return ::micros();
+  }
+
+  void delay(uint32_t ms)
+  {
+    ::delay(ms);
+  }
+
+  void startTimeSync(const char *ntpServer)
+  {
+    configTime(0, 0, ntpServer);
+  }
+
+  void wifiBegin(const char *ssid, const char *password)
+  {
+    WiFi.begin(ssid, password);
+  }
+
+  bool wifiConnected()
+  {
+    return WiFi.status() == WL_CONNECTED;
+  }
+
+  std::string wifiAddress()
+  {
+    return WiFi.localIP().toString().c_str();
+  }
+
+  std::string macAddress()
+  {
+    return WiFi.macAddress().c_str();
+  }
+
+  int wifiRssi()
+  {
+    return WiFi.RSSI();
+  }
+
+  bool mdnsBegin(const char *hostname)
+  {
+    return MDNS.begin(hostname);
+  }
+
+  bool mdnsFind(const char *service, const char *proto, std::string &host, uint16_t &port)
+  {
+    if (MDNS.queryService(service, proto) == 0)
+    {
+      return false;
+    }
+    host = MDNS.IP(0).toString().c_str();
+    port = MDNS.port(0);
+    return true;
+  }
+
+  size_t nvsRead(const char *space, const char *key, void *data, size_t length)
+  {
+    Preferences preferences;
+    if (!preferences.begin(space, true))
+    {
+      return 0;
+    }
+    size_t read = preferences.getBytesLength(key) == length ? preferences.getBytes(key, data, length) : 0;
+    preferences.end();
+    return read;
+  }
+
+  bool nvsWrite(const char *space, const char *key, const void *data, size_t length)
+  {
+    Preferences preferences;
+    if (!preferences.begin(space, false))
+    {
+      return false;
+    }
+    bool written = preferences.putBytes(key, data, length) == length;
+    preferences.end();
+    return written;
+  }
+
+  int32_t stackHighWater(const char *task)
+  {
+    TaskHandle_t handle = xTaskGetHandle(task);
+    return handle ? (int32_t)(uxTaskGetStackHighWaterMark(handle) * sizeof(StackType_t)) : -1;
+  }
+
+  bool onMainTask()
+  {
+    static TaskHandle_t loopTask = nullptr;
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    if (!current)
+    {
+      return false; // Scheduler not started yet
+    }
+    if (!loopTask)
+    {
+      loopTask = xTaskGetHandle("loopTask");
+    }
+    return current == loopTask;
+  }
+
+  void displayBegin()
+  {
+    tft.init(); // Also switches the backlight on (TFT_BL)
+    tft.setRotation(2);
+  }
+
+  void displayFlush(int32_t x, int32_t y, uint32_t width, uint32_t height, const uint16_t *pixels)
+  {
+    tft.startWrite();
+    tft.setAddrWindow(x, y, width, height);
+    tft.pushPixels((uint16_t *)pixels, width * height);
+    tft.endWrite();
+  }
+
+  void backlight(bool on)
+  {
+    digitalWrite(LCD_BACKLIGHT_PIN, on ? HIGH : LOW);
+  }
+}
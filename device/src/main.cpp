@@ -1,35 +1,70 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
-#include <TFT_eSPI.h>
-#include <ESPmDNS.h>
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
+#include <LittleFS.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdarg.h>
 #include <vector>
 #include <lvgl.h>
 #include "ui/ui.h"
+#include "Hal.h"
 #include "MQTTDispatcher.h"
+#include "TopicTokenizer.h"
+#include "MqttPacket.h"
+#include "MetricsRegistry.h"
+#include "SensorRegistry.h"
+#include "SensorStore.h"
+#include "SensorHistory.h"
+#include "AlertEngine.h"
+#include "LittleFSLogStorage.h"
+#include "PublishQueue.h"
+#include "StreamingClient.h"
+#include "SendStamp.h"
+#include "LatencyTrace.h"
+#include "TraceRing.h"
+#include "AllocTracker.h"
+#include "MemoryMonitor.h"
+#include "ArduinoTransport.h"
 #include "secrets.h"
 
+#if defined(MQTT_TLS_CA_CERT) || defined(MQTT_TLS_PSK_IDENTITY)
+#define MQTT_USE_TLS 1
+#include "TlsClient.h"
+// Provisioning hands out the plain port; default to utils/mosquitto's TLS listeners
+#ifndef MQTT_TLS_PORT
+#ifdef MQTT_TLS_PSK_IDENTITY
+#define MQTT_TLS_PORT 8884
+#else
+#define MQTT_TLS_PORT 8883
+#endif
+#endif
+#endif
+
 #define XPT2046_IRQ 36  // T_IRQ
 #define XPT2046_MOSI 32 // T_DIN
 #define XPT2046_MISO 39 // T_OUT
 #define XPT2046_CLK 25  // T_CLK
 #define XPT2046_CS 33   // T_CS
-#define LCD_BACKLIGHT_PIN 21
 
 // WiFi credentials
 const char *ssid = WIFI_SSID;
 const char *password = WIFI_PASSWORD;
 
-// MQTT broker - will be discovered via provisioning service
-String mqtt_server = ""; // Will be set by provisioning service
-int mqtt_port = 1883;    // Will be set by provisioning service
-String mqtt_username = ""; // Will be set by provisioning service
-String mqtt_password = ""; // Will be set by provisioning service
+// MQTT broker - will be discovered via provisioning service. Fixed buffers: PubSubClient
+// keeps the server pointer, and rediscovery must not churn a fragmented heap.
+char mqtt_server[64] = ""; // Will be set by provisioning service
+int mqtt_port = 1883;      // Will be set by provisioning service
+char mqtt_username[64] = ""; // Will be set by provisioning service
+char mqtt_password[64] = ""; // Will be set by provisioning service
 bool mqtt_broker_found = false;
 const char *mqtt_topic = "home/livingroom/temperature";
 const char *mqtt_ha_topic = "homeassistant/sensor/#";
+// Discovery configs live at <prefix>/sensor/[<node_id>/]<object_id>/config
+const char *mqtt_ha_config_topic = "homeassistant/sensor/+/config";
+const char *mqtt_ha_node_config_topic = "homeassistant/sensor/+/+/config";
 
 // Display
 // Display configuration - matches EEZ Studio project settings
@@ -37,17 +72,110 @@ static const uint16_t screenWidth = 320;
 static const uint16_t screenHeight = 240;
 static lv_color_t buf1[screenWidth * 20]; // 20 lines buffer (20 horizontal rows)
 
-TFT_eSPI tft = TFT_eSPI(); // Uses settings from User_Setup.h
-
 WiFiClient espClient;
-PubSubClient client(espClient);
+#ifdef MQTT_USE_TLS
+TlsClient tlsClient(espClient); // Keeps the TLS session so reconnects resume instead of renegotiating
+ClientTransport networkTransport(tlsClient);
+#else
+ClientTransport networkTransport(espClient);
+#endif
+TransportClient transportClient(networkTransport); // The MQTT stack sees only the Transport interface
+StreamingClient streamingClient(transportClient); // Diverts PUBLISH packets too big for PubSubClient's buffer
+PubSubClient client(streamingClient);
 MQTTDispatcher mqttDispatcher;
+MetricsRegistry metricsRegistry;
+PublishQueue publishQueue;
+SensorRegistry sensorRegistry;
+using DeviceSensorStore = SensorStore<SensorRegistry::Capacity>;
+DeviceSensorStore sensorStore;
+DeviceSensorStore::Snapshot metricsSnapshot;
+UnitTable unitTable;
+uint8_t local_temperature_slot = SensorRegistry::NoSlot;
+
+AlertEngine alertEngine;
+std::string alert_topic_prefix; // cyd/<device>/alerts/
+bool alert_ui_dirty = false;
+unsigned long alert_flash_until = 0;
+
+// Publish-to-pixel latency of stamped messages (mqtt_loadgen), reported per stage
+LatencyTrace<SensorRegistry::Capacity> latencyTrace;
+std::string latency_topic_prefix; // cyd/<device>/latency/
+#ifdef CYD_NATIVE
+const unsigned long latency_report_interval = 10000;
+#else
+const unsigned long latency_report_interval = 60000;
+#endif
 
-// Device identification functions
-String getDeviceIdentifier()
+// Heap, LVGL pool and task stack health, sampled every few seconds; a limit that
+// holds for several samples restarts the device before an allocation fails
+MemoryMonitor memoryMonitor;
+std::string memory_topic_prefix; // cyd/<device>/memory/
+const unsigned long memory_check_interval = 5000;
+struct MemoryRestartRecord
 {
-  // Use MAC address as serial number (most common approach)
-  return WiFi.macAddress();
+  uint32_t count;
+  char reason[44];
+};
+MemoryRestartRecord memory_restart_record = {};
+struct MonitoredTask
+{
+  const char *task;
+  const char *metric;
+};
+const MonitoredTask monitored_tasks[] = {
+  {"loopTask", "stack_loop"},
+  {"tiT", "stack_tcpip"},
+  {"wifi", "stack_wifi"},
+  {"esp_timer", "stack_esp_timer"},
+  {"sys_evt", "stack_sys_evt"},
+};
+
+#ifdef CYD_TRACE
+// Main loop trace, dumped on request to cyd/<device>/trace/data or as hex on Serial
+TraceRing traceRing;
+std::string trace_topic_prefix; // cyd/<device>/trace/
+bool trace_dump_requested = false;
+#endif
+
+#ifdef CYD_ALLOC_TRACK
+// Allocation counts by scope, sent to cyd/<device>/alloc/data when asked on .../alloc/dump
+std::string alloc_topic_prefix; // cyd/<device>/alloc/
+bool alloc_dump_requested = false;
+#endif
+
+// Sensor values persisted to flash: 64 segments x 8 pages x 512 B = 256 KB, ~21k records
+LittleFSLogStorage logStorage(64, 8);
+TimeSeriesLog sensorLog(logStorage);
+bool sensor_log_ready = false;
+std::string log_topic_prefix; // cyd/<device>/log/
+TimeSeriesLog::Cursor log_export_cursor = {0, true};
+uint32_t log_export_records = 0;
+
+// 24 h temperature trend, LTTB-downsampled from the minute buckets to one point per pixel column
+static const uint16_t chartWidth = 300;
+static const uint16_t chartHeight = 68;
+SensorHistory<> chartHistory;
+UptimeClock chartClock; // millis() wraps after 49.7 days, the chart must not
+uint8_t chart_slot = SensorRegistry::NoSlot;
+bool chart_dirty = false;
+lv_obj_t *trend_chart = nullptr;
+lv_chart_series_t *trend_series = nullptr;
+static int32_t chart_x[chartWidth];
+static int32_t chart_y[chartWidth];
+static float lttb_x[SensorHistory<>::MinuteCapacity];
+static float lttb_y[SensorHistory<>::MinuteCapacity];
+static uint16_t lttb_selected[chartWidth];
+
+// Device identification functions; each is formatted once into a static buffer
+const char *getDeviceIdentifier()
+{
+  // Use MAC address as serial number (most common approach), "AA:BB:CC:DD:EE:FF"
+  static char identifier[18] = "";
+  if (!identifier[0])
+  {
+    snprintf(identifier, sizeof(identifier), "%s", hal::macAddress().c_str());
+  }
+  return identifier;
 }
 
 uint64_t getChipId()
@@ -55,22 +183,46 @@ uint64_t getChipId()
   return ESP.getEfuseMac();
 }
 
-String getChipIdString()
+// MAC without separators, usable as an MQTT topic level and HA unique_id prefix
+const char *getDeviceTopicId()
 {
-  uint64_t chipid = ESP.getEfuseMac();
-  return String((uint32_t)(chipid >> 32), HEX) + String((uint32_t)chipid, HEX);
+  static char topicId[17] = ""; // "cyd_" + 12 hex digits
+  if (!topicId[0])
+  {
+    size_t length = snprintf(topicId, sizeof(topicId), "cyd_");
+    for (const char *c = getDeviceIdentifier(); *c && length < sizeof(topicId) - 1; ++c)
+    {
+      if (*c != ':')
+      {
+        topicId[length++] = (char)tolower((unsigned char)*c);
+      }
+    }
+    topicId[length] = '\0';
+  }
+  return topicId;
+}
+
+const char *getChipIdString()
+{
+  static char chipId[17] = "";
+  if (!chipId[0])
+  {
+    uint64_t chipid = ESP.getEfuseMac();
+    snprintf(chipId, sizeof(chipId), "%x%x", (unsigned)(uint32_t)(chipid >> 32), (unsigned)(uint32_t)chipid);
+  }
+  return chipId;
 }
 
 void printDeviceInfo()
 {
   Serial.println("=== Device Information ===");
-  Serial.println("MAC Address (Serial): " + getDeviceIdentifier());
-  Serial.println("Chip ID: " + getChipIdString());
-  Serial.println("Chip Model: " + String(ESP.getChipModel()));
-  Serial.println("Chip Revision: " + String(ESP.getChipRevision()));
-  Serial.println("Flash Size: " + String(ESP.getFlashChipSize() / 1024 / 1024) + " MB");
-  Serial.println("Heap Size: " + String(ESP.getHeapSize()) + " bytes");
-  Serial.println("Free Heap: " + String(ESP.getFreeHeap()) + " bytes");
+  Serial.printf("MAC Address (Serial): %s\n", getDeviceIdentifier());
+  Serial.printf("Chip ID: %s\n", getChipIdString());
+  Serial.printf("Chip Model: %s\n", ESP.getChipModel());
+  Serial.printf("Chip Revision: %u\n", (unsigned)ESP.getChipRevision());
+  Serial.printf("Flash Size: %u MB\n", (unsigned)(ESP.getFlashChipSize() / 1024 / 1024));
+  Serial.printf("Heap Size: %u bytes\n", (unsigned)ESP.getHeapSize());
+  Serial.printf("Free Heap: %u bytes\n", (unsigned)ESP.getFreeHeap());
   Serial.println("==========================");
 }
 
@@ -82,15 +234,33 @@ void log_print(lv_log_level_t level, const char *buf)
   Serial.flush();
 }
 
+// Serial.printf for lines logged from loop(): Print::printf mallocs a buffer for
+// anything longer than 64 characters, this formats into a static one
+void log_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void log_printf(const char *format, ...)
+{
+  static char line[192];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  Serial.print(line);
+}
+
 void display_flush(lv_display_t *display, const lv_area_t *area, uint8_t *color_p)
 {
+  TRACE_SCOPE(Flush);
   uint32_t w = (area->x2 - area->x1 + 1);
   uint32_t h = (area->y2 - area->y1 + 1);
 
-  tft.startWrite();
-  tft.setAddrWindow(area->x1, area->y1, w, h);
-  tft.pushPixels((uint16_t *)color_p, w * h);
-  tft.endWrite();
+  hal::displayFlush(area->x1, area->y1, w, h, (const uint16_t *)color_p);
+
+  if (latencyTrace.awaitingFlush())
+  {
+    lv_area_t widget;
+    lv_obj_get_coords(objects.label_temperature, &widget);
+    latencyTrace.flushed(area->y1 <= widget.y2 && area->y2 >= widget.y2 && area->x1 <= widget.x2 && area->x2 >= widget.x1, micros());
+  }
 
   lv_display_flush_ready(display); // Tell LVGL you are ready with the flushing
 }
@@ -98,22 +268,25 @@ void display_flush(lv_display_t *display, const lv_area_t *area, uint8_t *color_
 void setup_wifi()
 {
   delay(10);
-  WiFi.begin(ssid, password);
+  hal::wifiBegin(ssid, password);
   Serial.println("Connecting to WiFi...");
-  while (WiFi.status() != WL_CONNECTED)
+  while (!hal::wifiConnected())
   {
     delay(1000);
     Serial.println("  Connecting...");
     lv_label_set_text(objects.label_wifi_connected_state, "Connecting...");
   }
-  Serial.println("Connected to WiFi: " + WiFi.localIP().toString());
+  Serial.printf("Connected to WiFi: %s\n", hal::wifiAddress().c_str());
+
+  // Wall-clock time for the sensor log
+  hal::startTimeSync("pool.ntp.org");
   lv_label_set_text(objects.label_wifi_connected_state, "Connected");
 }
 
 void setup_mdns()
 {
   Serial.println("Setting up mDNS responder...");
-  while (!MDNS.begin(MDNS_HOSTNAME))
+  while (!hal::mdnsBegin(MDNS_HOSTNAME))
   {
     Serial.println("Error setting up MDNS responder...");
     delay(1000);
@@ -123,64 +296,64 @@ void setup_mdns()
 
 bool discover_mqtt_broker()
 {
+  ALLOC_SCOPE(Provisioning);
+  ALLOC_PERMIT();
   Serial.println("Discovering provisioning service via mDNS...");
   lv_label_set_text(objects.label_mqtt_connection_state, "Finding provisioning...");
 
-  // Query for CYD provisioning service
-  int n = MDNS.queryService("cyd-provision", "tcp");
-  if (n == 0)
+  // Query for CYD provisioning service, using the first one found
+  std::string provisionHost;
+  uint16_t provisionServicePort = 0;
+  if (!hal::mdnsFind("cyd-provision", "tcp", provisionHost, provisionServicePort))
   {
     Serial.println("No CYD provisioning services found");
     lv_label_set_text(objects.label_mqtt_connection_state, "No provisioning service");
     return false;
   }
 
-  Serial.printf("Found %d provisioning service(s)\n", n);
-  
-  // Use the first provisioning service found
-  String provisionIP = MDNS.IP(0).toString();
-  int provisionPort = MDNS.port(0);
+  const char *provisionIP = provisionHost.c_str();
+  int provisionPort = provisionServicePort;
   
-  Serial.printf("Contacting provisioning service: %s:%d\n", provisionIP.c_str(), provisionPort);
+  Serial.printf("Contacting provisioning service: %s:%d\n", provisionIP, provisionPort);
   lv_label_set_text(objects.label_mqtt_connection_state, "Contacting provisioning...");
 
   // Connect to provisioning service via TCP
   WiFiClient provisionClient;
-  if (!provisionClient.connect(provisionIP.c_str(), provisionPort))
+  if (!provisionClient.connect(provisionIP, provisionPort))
   {
     Serial.println("Failed to connect to provisioning service");
     lv_label_set_text(objects.label_mqtt_connection_state, "Provisioning failed");
     return false;
   }
 
-  // Create provisioning request JSON
-  JsonDocument requestDoc;
-  requestDoc["device_id"] = getDeviceIdentifier();
-  requestDoc["device_type"] = "cyd-esp32";
-  requestDoc["mac_address"] = getChipIdString();
-  requestDoc["request_type"] = "mqtt_config";
-  
-  String requestJson;
-  serializeJson(requestDoc, requestJson);
+  // Create provisioning request JSON; every value is a fixed identifier that needs no escaping
+  char requestJson[160];
+  const int requestLength = snprintf(requestJson, sizeof(requestJson),
+                                     "{\"device_id\":\"%s\",\"device_type\":\"cyd-esp32\",\"mac_address\":\"%s\",\"request_type\":\"mqtt_config\"}",
+                                     getDeviceIdentifier(), getChipIdString());
   
-  Serial.println("Sending provisioning request: " + requestJson);
+  Serial.print("Sending provisioning request: ");
+  Serial.println(requestJson);
 
   // Use HTTPClient for much simpler HTTP handling
   HTTPClient http;
-  String url = "http://" + provisionIP + ":" + String(provisionPort) + "/provision";
+  char url[96];
+  snprintf(url, sizeof(url), "http://%s:%d/provision", provisionIP, provisionPort);
   
   http.begin(url);
   http.addHeader("Content-Type", "application/json");
   http.setTimeout(5000); // 5 second timeout
   
   // Send POST request
-  int httpResponseCode = http.POST(requestJson);
+  int httpResponseCode = http.POST((uint8_t *)requestJson, (size_t)requestLength);
   
+  char status[64];
   if (httpResponseCode <= 0 || httpResponseCode != HTTP_CODE_OK)
   {
     // HTTPClient error (connection, timeout, etc.)
     Serial.printf("HTTPClient error: %s (code: %d)\n", http.errorToString(httpResponseCode).c_str(), httpResponseCode);
-    lv_label_set_text(objects.label_mqtt_connection_state, ("Connection error " + String(httpResponseCode)).c_str());
+    snprintf(status, sizeof(status), "Connection error %d", httpResponseCode);
+    lv_label_set_text(objects.label_mqtt_connection_state, status);
     http.end();
     return false;
   }
@@ -190,7 +363,8 @@ bool discover_mqtt_broker()
   http.end();
   
   Serial.printf("HTTP Response Code: %d\n", httpResponseCode);
-  Serial.println("Response: " + responseJson);
+  Serial.print("Response: ");
+  Serial.println(responseJson.c_str());
 
   // Parse JSON response
   JsonDocument responseDoc;
@@ -198,7 +372,7 @@ bool discover_mqtt_broker()
   
   if (error)
   {
-    Serial.println("Failed to parse provisioning response: " + String(error.c_str()));
+    Serial.printf("Failed to parse provisioning response: %s\n", error.c_str());
     lv_label_set_text(objects.label_mqtt_connection_state, "Invalid response");
     return false;
   }
@@ -206,98 +380,871 @@ bool discover_mqtt_broker()
   // Extract MQTT configuration
   if (responseDoc["status"] == "success")
   {
-    mqtt_server = responseDoc["mqtt_broker"].as<String>();
+    // Checked before anything is copied: truncated, the credentials would only show up
+    // later as an endless "Connection failed", and PubSubClient keeps pointing at mqtt_server
+    const char *broker = responseDoc["mqtt_broker"] | "";
+    const char *username = responseDoc["mqtt_username"] | "";
+    const char *password = responseDoc["mqtt_password"] | "";
+    if (strlen(broker) >= sizeof(mqtt_server) || strlen(username) >= sizeof(mqtt_username) ||
+        strlen(password) >= sizeof(mqtt_password))
+    {
+      Serial.printf("Provisioning failed: broker, username or password longer than %u characters\n",
+                    (unsigned)sizeof(mqtt_password) - 1);
+      lv_label_set_text(objects.label_mqtt_connection_state, "Broker config too long");
+      return false;
+    }
+    snprintf(mqtt_server, sizeof(mqtt_server), "%s", broker);
     mqtt_port = responseDoc["mqtt_port"].as<int>();
-    mqtt_username = responseDoc["mqtt_username"].as<String>();
-    mqtt_password = responseDoc["mqtt_password"].as<String>();
+#ifdef MQTT_USE_TLS
+    mqtt_port = MQTT_TLS_PORT;
+#endif
+    snprintf(mqtt_username, sizeof(mqtt_username), "%s", username);
+    snprintf(mqtt_password, sizeof(mqtt_password), "%s", password);
     
     mqtt_broker_found = true;
 
-    Serial.printf("Provisioned MQTT broker: %s:%d\n", mqtt_server.c_str(), mqtt_port);
-    Serial.printf("MQTT credentials: %s / %s\n", mqtt_username.c_str(), mqtt_password.c_str());
+    Serial.printf("Provisioned MQTT broker: %s:%d\n", mqtt_server, mqtt_port);
+    Serial.printf("MQTT credentials: %s / %s\n", mqtt_username, mqtt_password);
     
-    String status = "Provisioned: " + mqtt_server + ":" + String(mqtt_port);
-    lv_label_set_text(objects.label_mqtt_connection_state, status.c_str());
+    snprintf(status, sizeof(status), "Provisioned: %s:%d", mqtt_server, mqtt_port);
+    lv_label_set_text(objects.label_mqtt_connection_state, status);
     return true;
   }
   else
   {
-    String error = responseDoc["error"] | "Unknown error";
-    Serial.println("Provisioning failed: " + error);
-    lv_label_set_text(objects.label_mqtt_connection_state, ("Error: " + error).c_str());
+    const char *error = responseDoc["error"] | "Unknown error";
+    Serial.printf("Provisioning failed: %s\n", error);
+    snprintf(status, sizeof(status), "Error: %s", error);
+    lv_label_set_text(objects.label_mqtt_connection_state, status);
     return false;
   }
 }
 
-void test_handler(const std::string& topic, const std::string& message)
+// Retained payloads such as discovery configs exceed PubSubClient's buffer,
+// so they are streamed with beginPublish/endPublish instead of publish().
+bool mqtt_publish_bytes(const char *topic, const uint8_t *payload, size_t length, bool retained)
 {
-  std::string newMessage = message + std::string(" °C");
-  lv_label_set_text(objects.label_temperature, newMessage.c_str());
+  if (!client.beginPublish(topic, length, retained))
+  {
+    return false;
+  }
+  client.write(payload, length);
+  return client.endPublish() == 1;
 }
 
-// Simple split function similar to boost::split
-std::vector<std::string> split(const std::string& str, char delimiter)
+bool mqtt_publish(const char *topic, const char *payload, bool retained)
 {
-  std::vector<std::string> tokens;
-  size_t start = 0;
-  size_t end = 0;
-  
-  while ((end = str.find(delimiter, start)) != std::string::npos)
+  return mqtt_publish_bytes(topic, (const uint8_t *)payload, strlen(payload), retained);
+}
+
+// Queued publishes survive disconnects and are sent in batches from loop()
+bool queue_metric(const char *topic, const char *payload, bool retained)
+{
+  // Only into a free slot: a full queue would evict the states queued just before this one
+  return publishQueue.depth() < PublishQueue::Capacity &&
+         publishQueue.enqueue(topic, payload, retained, PublishQueue::Normal);
+}
+
+bool queue_discovery(const char *topic, const char *payload, bool retained)
+{
+  // Discovery JSON is cached by MetricsRegistry, so it can be queued by reference. Only use
+  // half the queue, so replayable configs never crowd out live data. Pinned, because the
+  // registry's cursor has moved past a config once it is queued: evicted, it would never go out.
+  return publishQueue.depth() < PublishQueue::Capacity / 2 &&
+         publishQueue.enqueueStatic(topic, payload, retained, PublishQueue::Bulk, true);
+}
+
+// Wall-clock seconds once NTP has synced, seconds since boot (flagged) before that
+void log_sensor_value(uint8_t slot, float value)
+{
+  if (!sensor_log_ready)
+  {
+    return;
+  }
+
+  ALLOC_PERMIT(); // A full page goes to LittleFS, whose file handles come from the heap
+  time_t now = time(nullptr);
+  if (now > 1700000000)
   {
-    if (end != start) // Skip empty tokens
+    sensorLog.append(slot, (uint32_t)now, value);
+  }
+  else
+  {
+    sensorLog.append(slot, millis() / 1000, value, LogRecord::UptimeClock);
+  }
+}
+
+// Only temperature sensors have a label on screen
+bool has_widget(uint8_t slot)
+{
+  return strcmp(sensorRegistry.info(slot).deviceClass, "temperature") == 0;
+}
+
+// Stores a state value; the label is redrawn from the store by render_dirty_sensors()
+void update_sensor(uint8_t slot, const ParsedPayload& value)
+{
+  // Values that never reach the screen would stay pending and count as superseded
+  if (has_widget(slot))
+  {
+    latencyTrace.dispatched(slot, micros());
+  }
+
+  switch (value.kind)
+  {
+  case ParsedPayload::Number:
+    sensorStore.update(slot, (float)value.value, millis(), unitTable.intern(sensorRegistry.info(slot).unit));
+    alertEngine.onValue(sensorRegistry.stateTopic(slot), (float)value.value, millis());
+    log_sensor_value(slot, (float)value.value);
+
+    // The first temperature sensor to report gets the trend chart
+    if (chart_slot == SensorRegistry::NoSlot && strcmp(sensorRegistry.info(slot).deviceClass, "temperature") == 0)
+    {
+      chart_slot = slot;
+    }
+    if (slot == chart_slot && (chartHistory.add((float)value.value, chartClock.seconds(millis())) & chartHistory.closed(chartHistory.Minute)))
     {
-      tokens.push_back(str.substr(start, end - start));
+      chart_dirty = true;
     }
-    start = end + 1;
+    break;
+  case ParsedPayload::Unavailable:
+  case ParsedPayload::Unknown:
+    sensorStore.setFlags(slot, DeviceSensorStore::Unavailable);
+    break;
+  default:
+    break; // Non-numeric state, nothing to store
   }
-  
-  // Add the last token
-  if (start < str.length())
+}
+
+// A sensor removed from HA frees its slot; whichever sensor gets it next starts clean
+void on_sensor_removed(uint8_t slot)
+{
+  sensorStore.clear(slot);
+  if (slot == chart_slot)
   {
-    tokens.push_back(str.substr(start));
+    chart_slot = SensorRegistry::NoSlot;
+    chartHistory.clear();
+    chart_dirty = true;
   }
-  
-  return tokens;
 }
 
-void ha_handler(const std::string& topic, const std::string& message)
+void test_handler(const std::string& topic, const ParsedPayload& value)
+{
+  update_sensor(local_temperature_slot, value);
+}
+
+void ha_config_handler(const std::string& topic, const std::string& message)
 {
-  if (topic.find("temperature") != std::string::npos && topic.rfind("state") == topic.length() - 5)
+  // Our own metrics come back as homeassistant/sensor/<device>/<metric>/config;
+  // registering them would fill the slots meant for real HA sensors
+  const auto levels = TopicTokenizer::tokenize(topic);
+  const char *self = getDeviceTopicId();
+  if (levels.count == 5 && levels.length[2] == strlen(self) && memcmp(topic.data() + levels.start[2], self, levels.length[2]) == 0)
   {
-    std::string newMessage = message + std::string(" °F");
-    lv_label_set_text(objects.label_temperature, newMessage.c_str());
-    
-    // Split topic by '/' and extract the third segment (index 2)
-    std::vector<std::string> topicParts = split(topic, '/');
-    std::string topicSegment = "";
-    
-    if (topicParts.size() > 2)
+    mqttDispatcher.ignore();
+    return;
+  }
+
+  ALLOC_PERMIT(); // A new sensor: JSON document and registry maps
+  sensorRegistry.onConfig(topic, message);
+}
+
+void ha_state_handler(const std::string& topic, const ParsedPayload& value)
+{
+  // Config topics never map to a slot, so only discovered state topics get through
+  uint8_t slot = sensorRegistry.find(topic);
+  if (slot == SensorRegistry::NoSlot)
+  {
+    mqttDispatcher.ignore();
+    return;
+  }
+
+  update_sensor(slot, value);
+}
+
+// Text of the sensor labels, kept in NVS so a power cycle starts from the last
+// reading (greyed out until a live one arrives) rather than "N/A"
+struct DisplaySnapshot
+{
+  uint32_t version;
+  char temperature[24];
+  char title[32];
+};
+const uint32_t display_snapshot_version = 1;
+const unsigned long display_snapshot_interval = 5 * 60 * 1000UL; // Bounds NVS wear
+DisplaySnapshot display_snapshot = {};
+bool display_snapshot_dirty = false;
+
+// Live label text; the labels point at these (lv_label_set_text_static) rather than
+// having LVGL reallocate a copy on every update
+char temperature_text[sizeof(DisplaySnapshot::temperature)];
+char topic_text[sizeof(DisplaySnapshot::title)];
+bool display_stale = false;
+bool first_live_frame_pending = false;
+unsigned long first_meaningful_frame_ms = 0; // Restored or live, whichever was drawn first
+unsigned long first_live_frame_ms = 0;
+
+void restore_display_snapshot()
+{
+  DisplaySnapshot saved = {};
+  if (hal::nvsRead("cyd-ui", "labels", &saved, sizeof(saved)) != sizeof(saved) || saved.version != display_snapshot_version)
+  {
+    return;
+  }
+
+  saved.temperature[sizeof(saved.temperature) - 1] = '\0';
+  saved.title[sizeof(saved.title) - 1] = '\0';
+  display_snapshot = saved;
+  lv_label_set_text(objects.label_temperature, saved.temperature);
+  lv_label_set_text(objects.label_mqtt_topic, saved.title);
+  lv_obj_set_style_text_color(objects.label_temperature, lv_color_hex(0xff9e9e9e), LV_PART_MAIN | LV_STATE_DEFAULT);
+  display_stale = true;
+}
+
+// Records what the labels show now; written out by save_display_snapshot()
+void remember_display()
+{
+  DisplaySnapshot current = {display_snapshot_version};
+  strncpy(current.temperature, lv_label_get_text(objects.label_temperature), sizeof(current.temperature) - 1);
+  strncpy(current.title, lv_label_get_text(objects.label_mqtt_topic), sizeof(current.title) - 1);
+  if (memcmp(&current, &display_snapshot, sizeof(current)) != 0)
+  {
+    display_snapshot = current;
+    display_snapshot_dirty = true;
+  }
+}
+
+void save_display_snapshot()
+{
+  static unsigned long lastSave = 0;
+  if (display_snapshot_dirty && millis() - lastSave >= display_snapshot_interval)
+  {
+    ALLOC_PERMIT(); // NVS handles are allocated per write
+    lastSave = millis();
+    display_snapshot_dirty = false;
+    hal::nvsWrite("cyd-ui", "labels", &display_snapshot, sizeof(display_snapshot));
+  }
+}
+
+// Redraws only the sensors that changed since the last frame
+void render_dirty_sensors()
+{
+  TRACE_SCOPE(RenderSensors);
+  ALLOC_SCOPE(Render);
+  sensorStore.forEachDirty([](size_t slot)
+  {
+    const SensorInfo& sensor = sensorRegistry.info(slot);
+    if (!has_widget(slot))
     {
-      topicSegment = topicParts[2]; // Extract 'c' from "a/b/c/d"
+      return;
+    }
+
+    if (sensorStore.flagsOf(slot) & DeviceSensorStore::Unavailable)
+    {
+      snprintf(temperature_text, sizeof(temperature_text), "N/A");
     }
     else
     {
-      topicSegment = topic; // Fallback to full topic
+      snprintf(temperature_text, sizeof(temperature_text), "%.1f %s", sensorStore.value(slot), unitTable.name(sensorStore.unitId(slot)));
     }
-    
-    lv_label_set_text(objects.label_mqtt_topic, topicSegment.c_str());
+    lv_label_set_text_static(objects.label_temperature, temperature_text);
+
+    if (display_stale)
+    {
+      display_stale = false;
+      lv_obj_set_style_text_color(objects.label_temperature, lv_color_hex(0xff000000), LV_PART_MAIN | LV_STATE_DEFAULT);
+    }
+    first_live_frame_pending = first_live_frame_ms == 0;
+    latencyTrace.rendered(slot, micros());
+
+    if (sensor.name[0] != '\0')
+    {
+      snprintf(topic_text, sizeof(topic_text), "%s", sensor.name);
+    }
+    else
+    {
+      // Unnamed sensor, fall back to the node id segment ('c' from "a/b/c/d")
+      const std::string& topic = sensorRegistry.stateTopic(slot);
+      const auto levels = TopicTokenizer::tokenize(topic);
+      if (levels.count > 2)
+      {
+        snprintf(topic_text, sizeof(topic_text), "%.*s", (int)levels.length[2], topic.c_str() + levels.start[2]);
+      }
+      else
+      {
+        snprintf(topic_text, sizeof(topic_text), "%s", topic.c_str());
+      }
+    }
+    lv_label_set_text_static(objects.label_mqtt_topic, topic_text);
+
+    remember_display();
+  });
+}
+
+void alert_config_handler(const std::string& topic, const std::string& message)
+{
+  ALLOC_PERMIT();
+  if (alertEngine.compile(message))
+  {
+    Serial.printf("Loaded %u alert rule(s)\n", (unsigned)alertEngine.size());
+  }
+  else
+  {
+    Serial.println("Invalid alert rule config");
+  }
+  alert_ui_dirty = true;
+}
+
+void on_alert_changed(const AlertRule& rule, float statistic)
+{
+  log_printf("Alert %s %s (%.2f)\n", rule.name, rule.active ? "raised" : "cleared", statistic);
+
+  char topic[PublishQueue::TopicSize];
+  char payload[64];
+  snprintf(topic, sizeof(topic), "%s%s", alert_topic_prefix.c_str(), rule.name);
+  snprintf(payload, sizeof(payload), "{\"state\":\"%s\",\"value\":%.2f}", rule.active ? "on" : "off", statistic);
+  publishQueue.enqueue(topic, payload, true, PublishQueue::Critical);
+
+  if (rule.active)
+  {
+    alert_flash_until = millis() + 5000;
+  }
+  alert_ui_dirty = true;
+}
+
+// Tints the screen while any alert is active and flashes the backlight when one is raised
+void render_alert_state()
+{
+  ALLOC_SCOPE(Render);
+  if (alert_ui_dirty)
+  {
+    alert_ui_dirty = false;
+    lv_obj_set_style_bg_color(objects.main, lv_color_hex(alertEngine.anyActive() ? 0xffffc0c0 : 0xffffffff), LV_PART_MAIN | LV_STATE_DEFAULT);
+  }
+
+  if (alert_flash_until != 0)
+  {
+    bool flashing = (long)(alert_flash_until - millis()) > 0;
+    hal::backlight(!flashing || (millis() / 250) % 2);
+    if (!flashing)
+    {
+      alert_flash_until = 0;
+    }
+  }
+}
+
+// Any message on cyd/<device>/log/export starts a streaming export of the flash log
+void log_export_handler(const std::string& topic, const std::string& message)
+{
+  if (!sensor_log_ready)
+  {
+    return;
+  }
+
+  ALLOC_PERMIT(); // On request only: the slot map is built as JSON
+  sensorLog.flush();
+  log_export_cursor = sensorLog.beginExport();
+  log_export_records = 0;
+
+  // Slots are assigned per boot, so send the slot -> state topic map first
+  JsonDocument slots;
+  for (uint8_t slot = 0; slot < SensorRegistry::Capacity; ++slot)
+  {
+    if (!sensorRegistry.stateTopic(slot).empty())
+    {
+      slots[std::to_string(slot)] = sensorRegistry.stateTopic(slot);
+    }
+  }
+  std::string payload;
+  serializeJson(slots, payload);
+  mqtt_publish((log_topic_prefix + "slots").c_str(), payload.c_str(), false);
+}
+
+// Publishes one log page per call, so an export never holds more than a page in RAM
+void pump_log_export()
+{
+  if (log_export_cursor.done)
+  {
+    return;
+  }
+
+  ALLOC_PERMIT(); // Pages are read back through LittleFS
+  LogRecord records[TimeSeriesLog::RecordsPerPage];
+  char topic[PublishQueue::TopicSize];
+  size_t count = sensorLog.exportNext(log_export_cursor, records);
+  if (count > 0)
+  {
+    snprintf(topic, sizeof(topic), "%schunk", log_topic_prefix.c_str());
+    mqtt_publish_bytes(topic, (const uint8_t *)records, count * sizeof(LogRecord), false);
+    log_export_records += count;
+  }
+  else
+  {
+    char total[16];
+    snprintf(topic, sizeof(topic), "%sdone", log_topic_prefix.c_str());
+    snprintf(total, sizeof(total), "%u", (unsigned)log_export_records);
+    mqtt_publish(topic, total, false);
+  }
+}
+
+void setup_log()
+{
+  if (!LittleFS.begin(true))
+  {
+    Serial.println("LittleFS mount failed - sensor log disabled");
+    return;
+  }
+
+  LittleFS.mkdir("/tslog");
+  sensorLog.begin();
+  sensor_log_ready = true;
+  Serial.println("Sensor log ready");
+}
+
+void setup_chart()
+{
+  trend_chart = lv_chart_create(objects.main);
+  lv_obj_set_pos(trend_chart, 10, 80);
+  lv_obj_set_size(trend_chart, chartWidth, chartHeight);
+  lv_obj_set_style_pad_all(trend_chart, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+  lv_obj_set_style_size(trend_chart, 0, 0, LV_PART_INDICATOR); // No point markers, just the line
+  lv_chart_set_type(trend_chart, LV_CHART_TYPE_SCATTER);
+  lv_chart_set_div_line_count(trend_chart, 3, 0);
+  lv_chart_set_point_count(trend_chart, chartWidth);
+  lv_chart_set_axis_range(trend_chart, LV_CHART_AXIS_PRIMARY_X, 0, SensorHistory<>::MinuteCapacity - 1);
+
+  // Point storage stays in our static arrays rather than the LVGL heap
+  trend_series = lv_chart_add_series(trend_chart, lv_palette_main(LV_PALETTE_BLUE), LV_CHART_AXIS_PRIMARY_Y);
+  for (uint16_t i = 0; i < chartWidth; ++i)
+  {
+    chart_x[i] = LV_CHART_POINT_NONE;
+    chart_y[i] = LV_CHART_POINT_NONE;
+  }
+  lv_chart_set_ext_x_array(trend_chart, trend_series, chart_x);
+  lv_chart_set_ext_y_array(trend_chart, trend_series, chart_y);
+}
+
+// Rebuilds the chart points; only called when a minute bucket has closed
+void render_chart()
+{
+  ALLOC_SCOPE(Render);
+  if (!chart_dirty)
+  {
+    return;
+  }
+  chart_dirty = false;
+
+  // Empty minutes (no samples) are left out so the line bridges the gap
+  const auto& minutes = chartHistory.minuteBuckets();
+  const size_t offset = minutes.capacity() - minutes.size();
+  size_t count = 0;
+  for (size_t i = 0; i < minutes.size(); ++i)
+  {
+    if (minutes[i].count > 0)
+    {
+      lttb_x[count] = offset + i;
+      lttb_y[count] = minutes[i].average();
+      ++count;
+    }
+  }
+
+  size_t selected = lttb(lttb_x, lttb_y, count, chartWidth, lttb_selected);
+  float low = INFINITY;
+  float high = -INFINITY;
+  for (size_t i = 0; i < chartWidth; ++i)
+  {
+    if (i < selected)
+    {
+      float y = lttb_y[lttb_selected[i]];
+      low = std::min(low, y);
+      high = std::max(high, y);
+      chart_x[i] = (int32_t)lttb_x[lttb_selected[i]];
+      chart_y[i] = (int32_t)lroundf(y * 10); // Tenths of a unit
+    }
+    else
+    {
+      chart_x[i] = LV_CHART_POINT_NONE;
+      chart_y[i] = LV_CHART_POINT_NONE;
+    }
+  }
+
+  if (selected > 0)
+  {
+    lv_chart_set_axis_range(trend_chart, LV_CHART_AXIS_PRIMARY_Y, (int32_t)floorf(low * 10) - 5, (int32_t)ceilf(high * 10) + 5);
   }
+  lv_chart_refresh(trend_chart);
 }
 
+// Subscriptions live in the broker session; after the first SUBSCRIBE of this boot a
+// resumed session already has them, and re-subscribing would replay every retained message
+bool subscribed_this_boot = false;
+
+// Messages received in the first seconds after each connect, to size the retained replay
+const unsigned long reconnect_burst_window = 10000;
+unsigned long connected_at = 0;
+uint32_t reconnect_burst = 0;
+bool reconnect_burst_open = false;
+
+// Publisher's send time to now, or -1 while our clock is not synced
+int64_t network_latency_us(uint64_t sentUs)
+{
+  timeval now;
+  gettimeofday(&now, nullptr);
+  const int64_t nowUs = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+  return now.tv_sec > 1700000000 && nowUs >= (int64_t)sentUs ? nowUs - (int64_t)sentUs : -1;
+}
+
+// Reused for every message; reserved to PubSubClient's buffer size in setup_mqtt(),
+// so assigning a message to them never reallocates
+std::string mqtt_topic_buffer;
+std::string mqtt_message_buffer;
+
 void mqtt_callback(char *topic, byte *payload, unsigned int length)
 {
-  std::string message((char*)payload, length);
+  // Load-test messages carry their send time in front of the value
+  uint64_t sentUs = 0;
+  const size_t stamp = SendStamp::parse((const char *)payload, length, sentUs);
+  if (stamp)
+  {
+    latencyTrace.received(network_latency_us(sentUs), micros());
+  }
+  std::string &message = mqtt_message_buffer;
+  message.assign((char*)payload + stamp, length - stamp);
+  mqtt_topic_buffer.assign(topic);
+
+  if (reconnect_burst_open)
+  {
+    ++reconnect_burst;
+  }
 
   Serial.print("Message arrived: ");
   Serial.print(message.c_str());
   Serial.print(" on topic: ");
   Serial.println(topic);
 
-  mqttDispatcher.dispatch(topic, message);
+  mqttDispatcher.dispatch(mqtt_topic_buffer, message);
+  latencyTrace.endMessage();
+}
+
+// Oversized payloads (typically HA discovery configs) streamed past PubSubClient
+void mqtt_chunk_callback(const std::string& topic, const uint8_t *data, size_t length, size_t offset, size_t total)
+{
+  ALLOC_PERMIT(); // Discovery configs and other bulk: parsed into the registries, pooled on first use
+  static size_t stamp = 0; // Send stamp at the front of the current message, always within its first chunk
+  if (offset == 0)
+  {
+    uint64_t sentUs = 0;
+    stamp = SendStamp::parse((const char *)data, length, sentUs);
+    if (stamp)
+    {
+      latencyTrace.received(network_latency_us(sentUs), micros());
+      data += stamp;
+      length -= stamp;
+    }
+    if (reconnect_burst_open)
+    {
+      ++reconnect_burst;
+    }
+    Serial.printf("Large message arrived: %u bytes on topic: %s\n", (unsigned)(total - stamp), topic.c_str());
+  }
+  else
+  {
+    offset -= stamp;
+  }
+  mqttDispatcher.dispatchChunk(topic, data, length, offset, total - stamp);
+  if (offset + length == total - stamp)
+  {
+    latencyTrace.endMessage();
+  }
+}
+
+// Subscribes to the dispatcher's covering filters in a single SUBSCRIBE. Commands on
+// cyd/<device>/ are QoS 1, so the broker keeps them for us while we are offline; the HA
+// filters stay QoS 0, or every state change missed offline would be replayed on reconnect
+// (retained configs and states still arrive when we subscribe).
+void subscribe_all()
+{
+  char devicePrefix[32];
+  const size_t prefixLength = snprintf(devicePrefix, sizeof(devicePrefix), "cyd/%s/", getDeviceTopicId());
+  std::vector<std::string> filters;
+  std::vector<uint8_t> qos;
+  for (const auto& subscription : mqttDispatcher.subscriptions())
+  {
+    filters.push_back(subscription.filter);
+    qos.push_back(subscription.filter.compare(0, prefixLength, devicePrefix) == 0 ? 1 : 0);
+    Serial.printf("Subscribing to %s (QoS %u)\n", subscription.filter.c_str(), (unsigned)qos.back());
+  }
+  if (filters.empty())
+  {
+    return;
+  }
+
+  // PubSubClient numbers its own packets from 1 and ignores the SUBACK
+  const std::vector<uint8_t> packet = MqttPacket::subscribe(0xFF00, filters, qos);
+  streamingClient.write(packet.data(), packet.size());
+}
+
+// Logs how much of each filter's traffic the handlers actually used since the last report
+void report_subscription_rates()
+{
+  static const size_t maxFilters = 16;
+  static unsigned long lastReport = 0;
+  static uint32_t previousReceived[maxFilters];
+  static uint32_t previousUsed[maxFilters];
+  static size_t previousCount = 0;
+  const unsigned long elapsed = millis() - lastReport;
+  if (elapsed < 60000)
+  {
+    return;
+  }
+  lastReport = millis();
+
+  // The filter set only changes with the registrations, so a matching count means the same filters
+  const auto& current = mqttDispatcher.subscriptions();
+  const bool comparable = previousCount == current.size();
+  for (size_t i = 0; i < current.size(); ++i)
+  {
+    const uint32_t received = current[i].received - (comparable ? previousReceived[i] : 0);
+    const uint32_t used = current[i].used - (comparable ? previousUsed[i] : 0);
+    log_printf("Filter %s: %.1f msg/min received, %.1f msg/min used\n", current[i].filter.c_str(),
+               received * 60000.0f / elapsed, used * 60000.0f / elapsed);
+    if (i < maxFilters)
+    {
+      previousReceived[i] = current[i].received;
+      previousUsed[i] = current[i].used;
+    }
+  }
+  previousCount = current.size() <= maxFilters ? current.size() : 0;
+}
+
+MemorySample take_memory_sample()
+{
+  MemorySample sample = {ESP.getFreeHeap(), ESP.getMaxAllocHeap(), ESP.getMinFreeHeap()};
+
+  // Only filled in when LVGL has its own pool (LV_STDLIB_BUILTIN); with LV_STDLIB_CLIB
+  // its allocations are part of the heap figures above
+  lv_mem_monitor_t lvgl;
+  lv_mem_monitor(&lvgl);
+  sample.lvglFree = lvgl.free_size;
+  sample.lvglLargest = lvgl.free_biggest_size;
+  sample.lvglFragmentation = lvgl.frag_pct;
+
+  sample.minStackFree = -1;
+  for (const auto &task : monitored_tasks)
+  {
+    const int32_t free = hal::stackHighWater(task.task);
+    if (free >= 0 && (sample.minStackFree < 0 || free < sample.minStackFree))
+    {
+      sample.minStackFree = free;
+      sample.minStackTask = task.task;
+    }
+  }
+  return sample;
+}
+
+// Saves what a restart would lose, records why, and reboots
+void memory_restart(const char *reason)
+{
+  ALLOC_PERMIT();
+  Serial.printf("Memory limit held for %u samples (%s), restarting\n", (unsigned)memoryMonitor.currentLimits().strikes, reason);
+
+  ++memory_restart_record.count;
+  strncpy(memory_restart_record.reason, reason, sizeof(memory_restart_record.reason) - 1);
+  hal::nvsWrite("cyd-mem", "restart", &memory_restart_record, sizeof(memory_restart_record));
+
+  if (client.connected())
+  {
+    char payload[96];
+    snprintf(payload, sizeof(payload), "{\"reason\":\"%s\",\"uptime\":%lu}", reason, millis() / 1000);
+    mqtt_publish((memory_topic_prefix + "restart").c_str(), payload, true);
+    client.disconnect();
+  }
+  if (sensor_log_ready)
+  {
+    sensorLog.flush();
+  }
+  if (display_snapshot_dirty)
+  {
+    hal::nvsWrite("cyd-ui", "labels", &display_snapshot, sizeof(display_snapshot));
+  }
+
+  delay(100); // Let Serial drain
+  ESP.restart();
+}
+
+void check_memory()
+{
+  static unsigned long lastCheck = 0;
+  if (millis() - lastCheck < memory_check_interval)
+  {
+    return;
+  }
+  lastCheck = millis();
+
+  switch (memoryMonitor.check(take_memory_sample()))
+  {
+  case MemoryMonitor::Warning:
+    log_printf("Memory warning: %s\n", memoryMonitor.reason());
+    break;
+  case MemoryMonitor::Restart:
+    memory_restart(memoryMonitor.reason());
+    break;
+  default:
+    break;
+  }
+}
+
+void memory_config_handler(const std::string& topic, const std::string& message)
+{
+  ALLOC_PERMIT();
+  if (!memoryMonitor.configure(message))
+  {
+    Serial.println("Invalid memory limit config");
+    return;
+  }
+  const MemoryLimits &limits = memoryMonitor.currentLimits();
+  Serial.printf("Memory limits: free heap %u, largest block %u, fragmentation %u%%, stack %d, %u strikes\n",
+                (unsigned)limits.minFreeHeap, (unsigned)limits.minLargestBlock, (unsigned)limits.maxFragmentation,
+                (int)limits.minStackFree, (unsigned)limits.strikes);
+}
+
+#ifdef CYD_TRACE
+#ifdef CYD_NATIVE
+const uint32_t trace_ticks_per_us = 1000; // Trace::ticks() counts nanoseconds on a host
+#else
+const uint32_t trace_ticks_per_us = getCpuFrequencyMhz();
+#endif
+
+void trace_dump_handler(const std::string& topic, const std::string& message)
+{
+  trace_dump_requested = true; // Sent from loop(), outside the dispatch being traced
+}
+
+// Sends the trace ring when asked over MQTT, or when "trace" is typed on Serial.
+// The Serial form is hex lines for trace_to_chrome to pick out of a monitor log.
+void pump_trace_dump()
+{
+  static char command[8];
+  static size_t commandLength = 0;
+  while (Serial.available() > 0)
+  {
+    const char c = (char)Serial.read();
+    if (c != '\n' && c != '\r')
+    {
+      command[commandLength < sizeof(command) - 1 ? commandLength++ : commandLength] = c;
+      continue;
+    }
+    command[commandLength] = '\0';
+    commandLength = 0;
+    if (strcmp(command, "trace") != 0)
+    {
+      continue;
+    }
+    size_t column = 0;
+    Serial.print("TRACE ");
+    traceRing.dump(trace_ticks_per_us, [&column](const uint8_t *data, size_t length)
+    {
+      for (size_t i = 0; i < length; ++i, ++column)
+      {
+        Serial.printf(column > 0 && column % 64 == 0 ? "\nTRACE %02x" : "%02x", data[i]);
+      }
+    });
+    Serial.println("\nTRACE END");
+  }
+
+  if (trace_dump_requested && client.connected())
+  {
+    trace_dump_requested = false;
+    char topic[PublishQueue::TopicSize];
+    snprintf(topic, sizeof(topic), "%sdata", trace_topic_prefix.c_str());
+    if (client.beginPublish(topic, traceRing.dumpSize(), false))
+    {
+      traceRing.dump(trace_ticks_per_us, [](const uint8_t *data, size_t length) { client.write(data, length); });
+      client.endPublish();
+    }
+  }
+}
+#endif
+
+#ifdef CYD_ALLOC_TRACK
+// An empty payload asks for the counts; "reset" zeroes them to measure a fresh window
+void alloc_dump_handler(const std::string& topic, const std::string& message)
+{
+  if (message == "reset")
+  {
+    AllocTracker::reset();
+    return;
+  }
+  alloc_dump_requested = true; // Sent from loop(), outside the dispatch being counted
+}
+
+// Logs the counts on the latency report interval and publishes them when asked
+void report_allocations()
+{
+  static unsigned long lastReport = 0;
+  const bool due = millis() - lastReport >= latency_report_interval;
+  if (!due && !alloc_dump_requested)
+  {
+    return;
+  }
+
+  static char payload[512];
+  const size_t length = AllocTracker::toJson(payload, sizeof(payload));
+  if (due)
+  {
+    lastReport = millis();
+    Serial.print("Allocations: ");
+    Serial.println(payload);
+  }
+  if (alloc_dump_requested && length && client.connected())
+  {
+    alloc_dump_requested = false;
+    char topic[PublishQueue::TopicSize];
+    snprintf(topic, sizeof(topic), "%sdata", alloc_topic_prefix.c_str());
+    mqtt_publish_bytes(topic, (const uint8_t *)payload, length, false);
+  }
+}
+#endif
+
+// Logs and publishes each stage's latency histogram for the stamped messages drawn since the last report
+void report_latency()
+{
+  static unsigned long lastReport = 0;
+  if (millis() - lastReport < latency_report_interval)
+  {
+    return;
+  }
+  lastReport = millis();
+  if (latencyTrace.histogram(latencyTrace.Flush).count() == 0)
+  {
+    return;
+  }
+
+  static char payload[1024];
+  for (uint8_t i = 0; i < latencyTrace.StageCount; ++i)
+  {
+    const auto stage = (decltype(latencyTrace)::Stage)i;
+    const LatencyHistogram& histogram = latencyTrace.histogram(stage);
+    if (histogram.count() == 0)
+    {
+      continue;
+    }
+    log_printf("Latency %-8s n=%u p50=%u us p99=%u us max=%u us\n", latencyTrace.stageName(stage), (unsigned)histogram.count(),
+               (unsigned)histogram.percentile(0.5f), (unsigned)histogram.percentile(0.99f), (unsigned)histogram.max());
+    const size_t length = histogram.toJson(payload, sizeof(payload));
+    if (length && client.connected())
+    {
+      char topic[PublishQueue::TopicSize];
+      snprintf(topic, sizeof(topic), "%s%s", latency_topic_prefix.c_str(), latencyTrace.stageName(stage));
+      mqtt_publish_bytes(topic, (const uint8_t *)payload, length, false);
+    }
+  }
+  log_printf("Latency: %u stamped value(s) superseded before reaching the screen\n", (unsigned)latencyTrace.supersededCount());
+  latencyTrace.clear();
 }
 
 void reconnect()
 {
+  ALLOC_PERMIT(); // TCP/TLS setup, the client ID and the discovery JSON built on first connect
   if (!mqtt_broker_found)
   {
     Serial.println("No MQTT broker discovered - attempting discovery again...");
@@ -307,7 +1254,7 @@ void reconnect()
       return;
     }
     // Reconfigure client with newly discovered broker
-    client.setServer(mqtt_server.c_str(), mqtt_port);
+    client.setServer(mqtt_server, mqtt_port);
     client.setCallback(mqtt_callback);
   }
 
@@ -316,13 +1263,31 @@ void reconnect()
   while (!client.connected())
   {
     // Use provisioned credentials if available, otherwise fall back to secrets.h
-    const char* username = mqtt_username.length() > 0 ? mqtt_username.c_str() : MQTT_USER;
-    const char* password = mqtt_password.length() > 0 ? mqtt_password.c_str() : MQTT_PASSWORD;
+    const char* username = mqtt_username[0] ? mqtt_username : MQTT_USER;
+    const char* password = mqtt_password[0] ? mqtt_password : MQTT_PASSWORD;
     
-    if (client.connect("ESP32-CYD", username, password))
+    // Persistent session under a per-device client ID so the broker keeps our subscriptions
+    char clientId[24];
+    snprintf(clientId, sizeof(clientId), "cyd-%s", getDeviceIdentifier());
+    if (client.connect(clientId, username, password, nullptr, 0, false, nullptr, false))
     {
-      client.subscribe(mqtt_topic);
-      client.subscribe(mqtt_ha_topic);
+#ifdef MQTT_USE_TLS
+      const TlsClient::HandshakeTiming& tls = tlsClient.lastHandshake();
+      Serial.printf("TLS %s handshake: %u ms (tcp %u, hello %u, server auth %u, key exchange %u, finish %u), %u B heap\n",
+                    tls.resumed ? "resumed" : "full", (unsigned)tls.total, (unsigned)tls.tcp, (unsigned)tls.hello,
+                    (unsigned)tls.serverAuth, (unsigned)tls.keyExchange, (unsigned)tls.finish, (unsigned)tls.heapUsed);
+#endif
+      const bool resumed = streamingClient.sessionPresent() && subscribed_this_boot;
+      if (!resumed)
+      {
+        subscribe_all();
+        subscribed_this_boot = true;
+      }
+      Serial.printf("MQTT session %s\n", resumed ? "resumed, skipping subscribe" : "new, subscribed");
+      connected_at = millis();
+      reconnect_burst = 0;
+      reconnect_burst_open = true;
+      metricsRegistry.beginDiscovery();
       Serial.println("Connected to MQTT with provisioned credentials");
     }
     else
@@ -337,17 +1302,150 @@ void reconnect()
   lv_label_set_text(objects.label_mqtt_connection_state, "Connected");
 }
 
+void setup_metrics()
+{
+  metricsRegistry.begin(getDeviceTopicId(), MDNS_HOSTNAME);
+  metricsRegistry.registerMetric("free_heap", "B", "data_size", []() { return (float)ESP.getFreeHeap(); });
+  metricsRegistry.registerMetric("wifi_rssi", "dBm", "signal_strength", []() { return (float)hal::wifiRssi(); });
+  metricsRegistry.registerMetric("uptime", "s", "duration", []() { return millis() / 1000.0f; });
+  metricsRegistry.registerMetric("publish_queue_depth", "", "", []() { return (float)publishQueue.depth(); });
+  metricsRegistry.registerMetric("publish_queue_dropped", "", "", []() { return (float)publishQueue.droppedTotal(); });
+  metricsRegistry.registerMetric("mqtt_oversized", "", "", []() { return (float)streamingClient.statistics().oversized; });
+  metricsRegistry.registerMetric("mqtt_oversized_dropped", "", "", []()
+  {
+    return (float)(streamingClient.statistics().dropped + mqttDispatcher.largeMessageStats().dropped);
+  });
+  metricsRegistry.registerMetric("mqtt_received", "", "", []()
+  {
+    uint32_t received = 0;
+    for (const auto& subscription : mqttDispatcher.subscriptions())
+    {
+      received += subscription.received;
+    }
+    return (float)received;
+  });
+  metricsRegistry.registerMetric("mqtt_unused", "", "", []()
+  {
+    // Delivered by a subscription but of no use to any handler; a pattern worth narrowing
+    uint32_t unused = 0;
+    for (const auto& subscription : mqttDispatcher.subscriptions())
+    {
+      unused += subscription.received - subscription.used;
+    }
+    return (float)unused;
+  });
+  metricsRegistry.registerMetric("mqtt_reconnect_burst", "", "", []() { return (float)reconnect_burst; });
+  metricsRegistry.registerMetric("first_frame", "ms", "duration", []() { return (float)first_meaningful_frame_ms; });
+#ifdef MQTT_USE_TLS
+  metricsRegistry.registerMetric("tls_handshake", "ms", "duration", []() { return (float)tlsClient.lastHandshake().total; });
+  metricsRegistry.registerMetric("tls_resumed", "", "", []() { return (float)tlsClient.statistics().resumedHandshakes; });
+#endif
+  metricsRegistry.registerMetric("heap_largest_block", "B", "data_size", []() { return (float)memoryMonitor.lastSample().largestBlock; });
+  metricsRegistry.registerMetric("heap_min_free", "B", "data_size", []() { return (float)memoryMonitor.lastSample().minFreeHeap; });
+  metricsRegistry.registerMetric("heap_fragmentation", "%", "", []() { return (float)MemoryMonitor::fragmentation(memoryMonitor.lastSample()); });
+  metricsRegistry.registerMetric("memory_warnings", "", "", []() { return (float)memoryMonitor.warningCount(); });
+  metricsRegistry.registerMetric("memory_restarts", "", "", []() { return (float)memory_restart_record.count; });
+  if (take_memory_sample().lvglFree > 0)
+  {
+    metricsRegistry.registerMetric("lvgl_mem_free", "B", "data_size", []() { return (float)memoryMonitor.lastSample().lvglFree; });
+    metricsRegistry.registerMetric("lvgl_fragmentation", "%", "", []() { return (float)memoryMonitor.lastSample().lvglFragmentation; });
+  }
+#ifdef CYD_NO_HEAP_AFTER_BOOT
+  metricsRegistry.registerMetric("heap_after_boot", "", "", []() { return (float)AllocTracker::violations(); });
+#endif
+#ifdef CYD_ALLOC_TRACK
+  for (uint8_t scope = 0; scope < AllocTracker::ScopeCount; ++scope)
+  {
+    const std::string name = std::string("alloc_") + AllocTracker::name(scope);
+    const auto s = (AllocTracker::Scope)scope;
+    metricsRegistry.registerMetric(name, "", "", [s]() { return (float)AllocTracker::totals(s).count; });
+    metricsRegistry.registerMetric(name + "_bytes", "B", "data_size", [s]() { return (float)AllocTracker::totals(s).bytes; });
+  }
+#endif
+  for (const auto &task : monitored_tasks)
+  {
+    if (hal::stackHighWater(task.task) >= 0)
+    {
+      const char *name = task.task;
+      metricsRegistry.registerMetric(task.metric, "B", "data_size", [name]() { return (float)hal::stackHighWater(name); });
+    }
+  }
+  metricsRegistry.registerMetric("sensor_max_age", "s", "duration", []()
+  {
+    // Age of the least recently updated sensor, from the snapshot taken before publishing
+    uint32_t oldest = 0;
+    for (size_t slot = 0; slot < SensorRegistry::Capacity; ++slot)
+    {
+      if (metricsSnapshot.flags[slot] & DeviceSensorStore::Valid)
+      {
+        oldest = std::max(oldest, (uint32_t)millis() - metricsSnapshot.timestamps[slot]);
+      }
+    }
+    return oldest / 1000.0f;
+  });
+}
+
+// The receive path: buffers sized to PubSubClient's, the chunk sink and every dispatcher
+// route. Set up whether or not a broker is found, so a later rediscovery has its handlers.
+void setup_mqtt_receive()
+{
+  streamingClient.setPassthroughLimit(client.getBufferSize());
+  mqtt_topic_buffer.reserve(client.getBufferSize());
+  mqtt_message_buffer.reserve(client.getBufferSize());
+  streamingClient.setChunkSink(mqtt_chunk_callback);
+
+  sensorRegistry.setRemovalListener(on_sensor_removed);
+  local_temperature_slot = sensorRegistry.registerSensor(mqtt_topic, "Living room", "°C", "temperature");
+  mqttDispatcher.registerValueHandler(mqtt_topic, test_handler);
+  mqttDispatcher.registerHandler(mqtt_ha_config_topic, ha_config_handler);
+  mqttDispatcher.registerHandler(mqtt_ha_node_config_topic, ha_config_handler);
+  mqttDispatcher.registerValueHandler(mqtt_ha_topic, ha_state_handler);
+
+  // Rules arrive as a retained message so they survive device restarts
+  alert_topic_prefix = std::string("cyd/") + getDeviceTopicId() + "/alerts/";
+  alertEngine.setListener(on_alert_changed);
+  mqttDispatcher.registerHandler(alert_topic_prefix + "config", alert_config_handler);
+
+  log_topic_prefix = std::string("cyd/") + getDeviceTopicId() + "/log/";
+  latency_topic_prefix = std::string("cyd/") + getDeviceTopicId() + "/latency/";
+
+  // Limits arrive retained, like the alert rules; the defaults apply until then
+  memory_topic_prefix = std::string("cyd/") + getDeviceTopicId() + "/memory/";
+  mqttDispatcher.registerHandler(memory_topic_prefix + "config", memory_config_handler);
+#ifdef CYD_TRACE
+  trace_topic_prefix = std::string("cyd/") + getDeviceTopicId() + "/trace/";
+  mqttDispatcher.registerHandler(trace_topic_prefix + "dump", trace_dump_handler);
+#endif
+#ifdef CYD_ALLOC_TRACK
+  alloc_topic_prefix = std::string("cyd/") + getDeviceTopicId() + "/alloc/";
+  mqttDispatcher.registerHandler(alloc_topic_prefix + "dump", alloc_dump_handler);
+#endif
+  mqttDispatcher.registerHandler(log_topic_prefix + "export", log_export_handler);
+}
+
 void setup_mqtt()
 {
+#if defined(MQTT_TLS_PSK_IDENTITY)
+  static uint8_t pskKey[64];
+  size_t pskLength = 0;
+  for (const char* hex = MQTT_TLS_PSK_KEY; hex[0] && hex[1] && pskLength < sizeof(pskKey); hex += 2)
+  {
+    char pair[3] = {hex[0], hex[1], '\0'};
+    pskKey[pskLength++] = (uint8_t)strtoul(pair, nullptr, 16);
+  }
+  tlsClient.usePsk(MQTT_TLS_PSK_IDENTITY, pskKey, pskLength);
+#elif defined(MQTT_TLS_CA_CERT)
+  tlsClient.useCertificate(MQTT_TLS_CA_CERT);
+#endif
+
+  setup_mqtt_receive();
+
   // Discover MQTT broker via mDNS
   if (discover_mqtt_broker())
   {
-    client.setServer(mqtt_server.c_str(), mqtt_port);
+    client.setServer(mqtt_server, mqtt_port);
     client.setCallback(mqtt_callback);
     Serial.println("MQTT client configured with discovered broker");
-
-    mqttDispatcher.registerHandler(mqtt_topic, test_handler);
-    mqttDispatcher.registerHandler(mqtt_ha_topic, ha_handler);
   }
   else
   {
@@ -361,17 +1459,20 @@ void setup()
   Serial.begin(115200);
   delay(100);
 
-  String LVGL_Arduino = String("LVGL Library Version: ") + lv_version_major() + "." + lv_version_minor() + "." + lv_version_patch();
-  Serial.println(LVGL_Arduino);
+  Serial.printf("LVGL Library Version: %d.%d.%d\n", lv_version_major(), lv_version_minor(), lv_version_patch());
 
   Serial.println("In setup()");
 
   // Print device information
   printDeviceInfo();
+  if (hal::nvsRead("cyd-mem", "restart", &memory_restart_record, sizeof(memory_restart_record)) == sizeof(memory_restart_record))
+  {
+    memory_restart_record.reason[sizeof(memory_restart_record.reason) - 1] = '\0';
+    Serial.printf("Memory restarts so far: %u, last because of %s\n", (unsigned)memory_restart_record.count, memory_restart_record.reason);
+  }
 
   // Initialize TFT
-  tft.init();
-  tft.setRotation(2);
+  hal::displayBegin();
 
   // Initialize LVGL
   lv_init();
@@ -388,30 +1489,89 @@ void setup()
 
   // Initialize EEZ Studio generated UI
   ui_init();
+  setup_chart();
+  restore_display_snapshot();
 
   Serial.println("UI initialized and ready!");
 
   // Force initial screen refresh
   lv_refr_now(display);
+  if (display_stale)
+  {
+    first_meaningful_frame_ms = millis();
+    Serial.printf("First meaningful frame (restored) at %lu ms\n", first_meaningful_frame_ms);
+  }
 
+  setup_log();
   setup_wifi();
   setup_mdns();
+  setup_metrics();
   setup_mqtt();
 
   Serial.println("Awaiting messages...");
+#ifdef CYD_NO_HEAP_AFTER_BOOT
+  AllocTracker::seal();
+#endif
 }
 
 void loop()
 {
+  TRACE_SCOPE(Loop);
+#ifdef CYD_TRACE
+  pump_trace_dump();
+#endif
+
   // CRITICAL: Tell LVGL how much time has passed
   lv_tick_inc(3); // 3ms matches our delay below for faster refresh
 
+  // Push changed sensor values into their widgets before LVGL renders
+  render_dirty_sensors();
+
+  // Close history buckets on time even when the charted sensor goes quiet
+  static unsigned long lastHistoryAdvance = 0;
+  if (millis() - lastHistoryAdvance >= 1000)
+  {
+    lastHistoryAdvance = millis();
+    const uint32_t seconds = chartClock.seconds(millis()); // Every second, charted sensor or not, so no wrap is missed
+    if (chart_slot != SensorRegistry::NoSlot && (chartHistory.advance(seconds) & chartHistory.closed(chartHistory.Minute)))
+    {
+      chart_dirty = true;
+    }
+  }
+  render_chart();
+  render_alert_state();
+
+  // Bound what a power cut can lose without writing a mostly empty page every pass
+  static unsigned long lastLogFlush = 0;
+  if (sensor_log_ready && millis() - lastLogFlush > 5 * 60 * 1000UL)
+  {
+    lastLogFlush = millis();
+    ALLOC_PERMIT();
+    sensorLog.flush();
+  }
+
   // Handle LVGL tasks
-  lv_timer_handler();
+  {
+    TRACE_SCOPE(LvTimer);
+    ALLOC_SCOPE(Lvgl);
+    ALLOC_PERMIT(); // Draw tasks every frame; from LVGL's static pool when the heap is sealed, still counted
+    lv_timer_handler();
+  }
+
+  if (first_live_frame_pending)
+  {
+    first_live_frame_pending = false;
+    first_live_frame_ms = millis();
+    first_meaningful_frame_ms = first_meaningful_frame_ms ? first_meaningful_frame_ms : first_live_frame_ms;
+    log_printf("First live frame at %lu ms, first meaningful frame at %lu ms\n", first_live_frame_ms, first_meaningful_frame_ms);
+  }
+  save_display_snapshot();
 
   // Handle EEZ Studio UI updates
   ui_tick();
 
+  check_memory();
+
   // Small delay to prevent watchdog issues - reduced for faster refresh
   delay(3);
 
@@ -422,7 +1582,47 @@ void loop()
     {
       reconnect();
     }
-    client.loop();
+    {
+      TRACE_SCOPE(MqttLoop);
+      ALLOC_SCOPE(MqttLoop);
+      client.loop();
+    }
+
+    if (client.connected())
+    {
+      pump_log_export();
+    }
+    report_subscription_rates();
+    report_latency();
+#ifdef CYD_ALLOC_TRACK
+    report_allocations();
+#endif
+
+    if (reconnect_burst_open && millis() - connected_at > reconnect_burst_window)
+    {
+      reconnect_burst_open = false;
+      Serial.printf("Reconnect burst: %u messages in %lu ms\n", (unsigned)reconnect_burst, reconnect_burst_window);
+    }
+
+    // Hand discovery configs to the queue as it has room; they go out with the other traffic
+    metricsRegistry.publishDiscovery(queue_discovery, PublishQueue::Capacity);
+
+    static unsigned long lastMetricsPublish = 0;
+    if (millis() - lastMetricsPublish > 30000)
+    {
+      lastMetricsPublish = millis();
+      sensorStore.snapshot(metricsSnapshot);
+      metricsRegistry.beginStates();
+    }
+    // A batch per pass, matching the flush below, until the round is out
+    metricsRegistry.publishStates(queue_metric, 4);
+
+    if (client.connected())
+    {
+      TRACE_SCOPE(PublishFlush);
+      ALLOC_SCOPE(Publish);
+      publishQueue.flush(mqtt_publish_bytes, 4);
+    }
   }
   else
   {
@@ -434,7 +1634,7 @@ void loop()
       discover_mqtt_broker();
       if (mqtt_broker_found)
       {
-        client.setServer(mqtt_server.c_str(), mqtt_port);
+        client.setServer(mqtt_server, mqtt_port);
         client.setCallback(mqtt_callback);
       }
     }
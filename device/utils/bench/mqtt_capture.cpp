@@ -0,0 +1,114 @@
+// Records broker traffic into a capture file for env:native_replay (format in include/MqttCapture.h).
+// Build: g++ -std=c++17 -O2 -I../../include mqtt_capture.cpp -o mqtt_capture
+// Run:   ./mqtt_capture localhost 1883 ha.cap 600                   ten minutes of everything
+//        ./mqtt_capture localhost 1883 ha.cap 600 'homeassistant/#'  only some filters
+// Ctrl-C stops early and still writes the file. MQTT_USER / MQTT_PASSWORD are used when set.
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MqttCapture.h"
+#include "MqttPacket.h"
+#include "PosixTransport.h"
+
+using Clock = std::chrono::steady_clock;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void send(Transport& transport, const std::vector<uint8_t>& bytes)
+{
+  transport.send(bytes.data(), bytes.size());
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 5)
+  {
+    fprintf(stderr, "usage: %s host port file seconds [filter...]\n", argv[0]);
+    return 2;
+  }
+  const char* path = argv[3];
+  const auto duration = std::chrono::seconds(atoi(argv[4]));
+  std::vector<std::string> filters(argv + 5, argv + argc);
+  if (filters.empty())
+  {
+    filters.push_back("#");
+  }
+
+  PosixTransport transport;
+  if (!transport.open(argv[1], (uint16_t)atoi(argv[2])))
+  {
+    fprintf(stderr, "cannot connect to %s:%s\n", argv[1], argv[2]);
+    return 1;
+  }
+  const char* user = getenv("MQTT_USER");
+  const char* password = getenv("MQTT_PASSWORD");
+  send(transport, MqttPacket::connect("cyd-capture", user ? user : "", password ? password : "", 60, true));
+  send(transport, MqttPacket::subscribe(1, filters, 0));
+  signal(SIGINT, [](int) { stopping = 1; });
+
+  MqttPacket::Reader reader;
+  MqttCapture::Writer capture;
+  const auto start = Clock::now();
+  auto lastPing = start;
+  bool connected = false;
+  uint8_t buffer[4096];
+  while (!stopping && Clock::now() - start < duration)
+  {
+    const int n = transport.receive(buffer, sizeof(buffer));
+    if (n < 0)
+    {
+      fprintf(stderr, "broker closed the connection\n");
+      break;
+    }
+    if (n == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const uint64_t nowUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    size_t offset = 0;
+    while (offset < (size_t)n)
+    {
+      offset += reader.feed(buffer + offset, n - offset);
+      if (!reader.complete())
+      {
+        continue;
+      }
+      MqttPacket::PublishView view;
+      if (reader.type() == MqttPacket::Connack)
+      {
+        connected = reader.body().size() == 2 && reader.body()[1] == 0;
+        if (!connected)
+        {
+          fprintf(stderr, "broker refused the connection (%u)\n", reader.body().size() == 2 ? reader.body()[1] : 0);
+          return 1;
+        }
+      }
+      else if (MqttPacket::parsePublish(reader, view))
+      {
+        capture.add(nowUs, view.topic, view.payload, view.length, view.retained);
+      }
+    }
+
+    if (Clock::now() - lastPing > std::chrono::seconds(30))
+    {
+      send(transport, MqttPacket::packet(MqttPacket::Pingreq << 4, {}));
+      lastPing = Clock::now();
+    }
+  }
+  send(transport, MqttPacket::packet(MqttPacket::Disconnect << 4, {}));
+
+  if (!capture.save(path))
+  {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%zu messages on %zu topics in %.1f s, %zu bytes (%.1f bytes/message)\n", capture.messages(), capture.topics(),
+         seconds, capture.data().size(), capture.data().size() / (double)(capture.messages() ? capture.messages() : 1));
+  return 0;
+}
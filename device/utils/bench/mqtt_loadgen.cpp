@@ -0,0 +1,462 @@
+// Load generator for the broker and the device: publishes a configurable HA-like topic
+// mix at a target rate and, on a second connection, measures broker latency from the
+// send timestamps embedded in each payload (include/SendStamp.h).
+// Build: g++ -std=c++17 -O2 -pthread -I../../include mqtt_loadgen.cpp -o mqtt_loadgen
+// Run:   ./mqtt_loadgen                                     100 msg/s for 10 s against localhost:1883
+//        ./mqtt_loadgen --rate 2000 --duration 60 --sensors 200 --payload exp:120
+//        ./mqtt_loadgen --host mqtt.local --mix 50,0,50,0 --burst-every 15 --no-stamp
+// Options:
+//   --host H --port P      broker (default localhost 1883, the utils/mosquitto container);
+//                          MQTT_USER / MQTT_PASSWORD are used when set
+//   --rate N               messages per second (default 100)
+//   --duration S           seconds (default 10)
+//   --sensors N            distinct sensors per topic class (default 50)
+//   --mix A,B,C,D          weights of the topic classes (default 70,10,15,5):
+//                            A  homeassistant/sensor/loadgen_<i>/state     discovered sensor
+//                            B  homeassistant/sensor/loadgen/<i>/state     discovered, node_id style
+//                            C  homeassistant/sensor/stranger_<i>/state    never discovered, matched by '#' only
+//                            D  loadgen/noise/<i>                          outside the device's filters
+//   --payload D            state payload size: numeric (default), fixed:N, uniform:MIN:MAX or exp:MEAN;
+//                          sizes past the number are padded with spaces, which parsePayload() skips
+//   --burst-every S        republish every retained discovery config each S seconds, like an HA restart
+//   --no-discovery         skip the retained configs at start; otherwise they are cleared again
+//                          (empty retained payloads) on exit, Ctrl-C included
+//   --qos Q                0 (default) or 1
+//   --no-stamp             plain payloads; latency is then not measured
+//   --seed N               topic and value sequence (default 1)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MqttPacket.h"
+#include "PosixTransport.h"
+#include "SendStamp.h"
+
+using Clock = std::chrono::steady_clock;
+
+static volatile sig_atomic_t interrupted = 0;
+
+struct Options
+{
+  std::string host = "localhost";
+  uint16_t port = 1883;
+  double rate = 100;
+  double duration = 10;
+  size_t sensors = 50;
+  double mix[4] = {70, 10, 15, 5};
+  std::string payload = "numeric";
+  double burstEvery = 0;
+  bool discovery = true;
+  uint8_t qos = 0;
+  bool stamp = true;
+  unsigned seed = 1;
+};
+
+static uint64_t unixMicros()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string stateTopic(int topicClass, size_t sensor)
+{
+  switch (topicClass)
+  {
+  case 0:
+    return "homeassistant/sensor/loadgen_" + std::to_string(sensor) + "/state";
+  case 1:
+    return "homeassistant/sensor/loadgen/" + std::to_string(sensor) + "/state";
+  case 2:
+    return "homeassistant/sensor/stranger_" + std::to_string(sensor) + "/state";
+  default:
+    return "loadgen/noise/" + std::to_string(sensor);
+  }
+}
+
+// Discovery config as HA publishes it, device block included (~300 bytes, past PubSubClient's buffer)
+static std::string discoveryConfig(int topicClass, size_t sensor)
+{
+  const std::string id = (topicClass == 0 ? "loadgen_" : "loadgen_node_") + std::to_string(sensor);
+  return "{\"name\":\"Loadgen " + std::to_string(sensor) + "\",\"state_topic\":\"" + stateTopic(topicClass, sensor) +
+         "\",\"unit_of_measurement\":\"°C\",\"device_class\":\"temperature\",\"state_class\":\"measurement\","
+         "\"unique_id\":\"" + id + "\",\"device\":{\"identifiers\":[\"" + id + "\"],\"name\":\"Load generator\","
+         "\"manufacturer\":\"cyd_mqtt_sample\",\"model\":\"mqtt_loadgen\",\"sw_version\":\"1.0\"}}";
+}
+
+static std::string configTopic(int topicClass, size_t sensor)
+{
+  std::string topic = stateTopic(topicClass, sensor);
+  return topic.replace(topic.size() - 5, 5, "config");
+}
+
+// One of stateTopic()'s, so the probe ignores other publishers and the discovery configs
+static bool isStateTopic(const std::string& topic)
+{
+  static const char* const prefixes[] = {"homeassistant/sensor/loadgen_", "homeassistant/sensor/loadgen/",
+                                         "homeassistant/sensor/stranger_", "loadgen/noise/"};
+  static const std::string state = "/state";
+  for (const char* prefix : prefixes)
+  {
+    if (topic.compare(0, strlen(prefix), prefix) == 0)
+    {
+      return prefix[0] == 'l' ||
+             (topic.size() > state.size() && topic.compare(topic.size() - state.size(), state.size(), state) == 0);
+    }
+  }
+  return false;
+}
+
+// Size of the next state payload, 0 meaning just the number
+class PayloadSizes
+{
+public:
+  explicit PayloadSizes(const std::string& spec)
+  {
+    if (sscanf(spec.c_str(), "fixed:%zu", &low) == 1)
+    {
+      kind = Fixed;
+    }
+    else if (sscanf(spec.c_str(), "uniform:%zu:%zu", &low, &high) == 2 && high >= low)
+    {
+      kind = Uniform;
+    }
+    else if (sscanf(spec.c_str(), "exp:%lf", &mean) == 1 && mean > 0)
+    {
+      kind = Exponential;
+    }
+    else if (spec != "numeric")
+    {
+      fprintf(stderr, "unknown payload distribution %s\n", spec.c_str());
+      exit(2);
+    }
+  }
+
+  size_t next(std::mt19937& random)
+  {
+    switch (kind)
+    {
+    case Fixed:
+      return low;
+    case Uniform:
+      return std::uniform_int_distribution<size_t>(low, high)(random);
+    case Exponential:
+      return (size_t)std::exponential_distribution<double>(1 / mean)(random);
+    default:
+      return 0;
+    }
+  }
+
+private:
+  enum Kind { Numeric, Fixed, Uniform, Exponential } kind = Numeric;
+  size_t low = 0;
+  size_t high = 0;
+  double mean = 0;
+};
+
+static bool connect(PosixTransport& transport, const Options& options, const char* clientId)
+{
+  if (!transport.open(options.host.c_str(), options.port))
+  {
+    return false;
+  }
+  const char* user = getenv("MQTT_USER");
+  const char* password = getenv("MQTT_PASSWORD");
+  auto packet = MqttPacket::connect(clientId, user ? user : "", password ? password : "", 60, true);
+  transport.send(packet.data(), packet.size());
+  return true;
+}
+
+static void ping(PosixTransport& transport, Clock::time_point& last)
+{
+  if (Clock::now() - last > std::chrono::seconds(30))
+  {
+    auto packet = MqttPacket::packet(MqttPacket::Pingreq << 4, {});
+    transport.send(packet.data(), packet.size());
+    last = Clock::now();
+  }
+}
+
+// Second connection subscribed to everything the generator publishes
+class LatencyProbe
+{
+public:
+  bool start(const Options& options)
+  {
+    if (!connect(transport, options, "cyd-loadgen-probe"))
+    {
+      return false;
+    }
+    auto subscribe = MqttPacket::subscribe(1, {"homeassistant/sensor/#", "loadgen/#"}, 0);
+    transport.send(subscribe.data(), subscribe.size());
+    worker = std::thread([this] { run(); });
+    return true;
+  }
+
+  // Waits for stragglers, then stops
+  void finish(size_t expected)
+  {
+    auto deadline = Clock::now() + std::chrono::seconds(2);
+    while (received < expected && Clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stopping = true;
+    worker.join();
+  }
+
+  // Everything published since; retained replays of older runs are not counted
+  void arm() { armed = true; }
+
+  size_t messages() const { return received; }
+
+  std::vector<uint32_t> takeLatencies()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::move(latencyUs);
+  }
+
+private:
+  PosixTransport transport;
+  MqttPacket::Reader reader;
+  std::thread worker;
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> armed{false};
+  std::atomic<size_t> received{0};
+  std::mutex mutex;
+  std::vector<uint32_t> latencyUs;
+
+  void run()
+  {
+    uint8_t buffer[16384];
+    auto lastPing = Clock::now();
+    while (!stopping)
+    {
+      const int n = transport.receive(buffer, sizeof(buffer));
+      if (n < 0)
+      {
+        fprintf(stderr, "probe: broker closed the connection\n");
+        return;
+      }
+      if (n == 0)
+      {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+      const uint64_t nowUs = unixMicros();
+      size_t offset = 0;
+      while (offset < (size_t)n)
+      {
+        offset += reader.feed(buffer + offset, n - offset);
+        MqttPacket::PublishView view;
+        if (!reader.complete() || !MqttPacket::parsePublish(reader, view) || view.retained || !armed ||
+            !isStateTopic(view.topic))
+        {
+          continue;
+        }
+        ++received;
+        uint64_t sentUs;
+        if (SendStamp::parse((const char*)view.payload, view.length, sentUs) && nowUs >= sentUs)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          latencyUs.push_back((uint32_t)std::min<uint64_t>(nowUs - sentUs, UINT32_MAX));
+        }
+      }
+      ping(transport, lastPing);
+    }
+  }
+};
+
+static double percentile(std::vector<uint32_t>& samples, double p)
+{
+  if (samples.empty())
+  {
+    return 0;
+  }
+  auto at = samples.begin() + (size_t)(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), at, samples.end());
+  return *at;
+}
+
+static Options parseOptions(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--no-discovery") { options.discovery = false; continue; }
+    if (arg == "--no-stamp") { options.stamp = false; continue; }
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "%s needs a value (see the top of mqtt_loadgen.cpp)\n", arg.c_str());
+      exit(2);
+    }
+    ++i;
+    if (arg == "--host") options.host = value;
+    else if (arg == "--port") options.port = (uint16_t)atoi(value);
+    else if (arg == "--rate") options.rate = atof(value);
+    else if (arg == "--duration") options.duration = atof(value);
+    else if (arg == "--sensors") options.sensors = std::max(1, atoi(value));
+    else if (arg == "--payload") options.payload = value;
+    else if (arg == "--burst-every") options.burstEvery = atof(value);
+    else if (arg == "--qos") options.qos = atoi(value) ? 1 : 0;
+    else if (arg == "--seed") options.seed = (unsigned)atoi(value);
+    else if (arg == "--mix")
+    {
+      if (sscanf(value, "%lf,%lf,%lf,%lf", &options.mix[0], &options.mix[1], &options.mix[2], &options.mix[3]) != 4)
+      {
+        fprintf(stderr, "--mix takes four weights, e.g. 70,10,15,5\n");
+        exit(2);
+      }
+    }
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg.c_str());
+      exit(2);
+    }
+  }
+  return options;
+}
+
+int main(int argc, char** argv)
+{
+  const Options options = parseOptions(argc, argv);
+  PayloadSizes payloadSizes(options.payload);
+  std::mt19937 random(options.seed);
+  std::discrete_distribution<int> topicClasses(options.mix, options.mix + 4);
+  std::uniform_int_distribution<size_t> sensors(0, options.sensors - 1);
+  std::normal_distribution<double> values(21, 3);
+
+  LatencyProbe probe;
+  if (options.stamp && !probe.start(options))
+  {
+    fprintf(stderr, "cannot connect to %s:%u\n", options.host.c_str(), options.port);
+    return 1;
+  }
+  PosixTransport publisher;
+  if (!connect(publisher, options, "cyd-loadgen"))
+  {
+    fprintf(stderr, "cannot connect to %s:%u\n", options.host.c_str(), options.port);
+    return 1;
+  }
+
+  uint16_t packetId = 0;
+  size_t bytesSent = 0;
+  auto publish = [&](const std::string& topic, const std::string& payload, bool retained)
+  {
+    const uint8_t qos = retained ? 0 : options.qos;
+    packetId = packetId == 0xFFFF ? 1 : packetId + 1;
+    auto packet = MqttPacket::publish(topic, (const uint8_t*)payload.data(), payload.size(), qos, retained, packetId);
+    bytesSent += publisher.send(packet.data(), packet.size());
+  };
+  // Retained configs outlive the run: left behind, HA would keep the entities and every
+  // device would fill its sensor slots with them on each subscribe
+  auto publishDiscovery = [&](bool clear)
+  {
+    for (int topicClass = 0; topicClass < 2; ++topicClass)
+    {
+      for (size_t sensor = 0; options.mix[topicClass] > 0 && sensor < options.sensors; ++sensor)
+      {
+        publish(configTopic(topicClass, sensor), clear ? std::string() : discoveryConfig(topicClass, sensor), true);
+      }
+    }
+  };
+  const bool discoveryPublished = options.discovery || options.burstEvery > 0;
+  if (options.discovery)
+  {
+    publishDiscovery(false);
+  }
+  signal(SIGINT, [](int) { interrupted = 1; });
+
+  // Give the probe's SUBSCRIBE time to land so the first messages are counted
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  probe.arm();
+
+  const size_t total = (size_t)(options.rate * options.duration);
+  const auto interval = std::chrono::duration<double>(1 / options.rate);
+  const auto start = Clock::now();
+  auto lastBurst = start;
+  auto lastReport = start;
+  auto lastPing = start;
+  size_t late = 0;
+  size_t sent = 0;
+  size_t sentAtReport = 0;
+  size_t largest = 0;
+  uint8_t drain[4096];
+  for (size_t i = 0; i < total && !interrupted; ++i)
+  {
+    const auto due = start + std::chrono::duration_cast<Clock::duration>(interval * (double)i);
+    if (Clock::now() < due)
+    {
+      std::this_thread::sleep_until(due);
+    }
+    else if (Clock::now() - due > std::chrono::milliseconds(100))
+    {
+      ++late;
+    }
+
+    const int topicClass = topicClasses(random);
+    char number[16];
+    snprintf(number, sizeof(number), "%.2f", values(random));
+    std::string payload = number;
+    payload.resize(std::max(payload.size(), payloadSizes.next(random)), ' ');
+    if (options.stamp)
+    {
+      SendStamp::prepend(payload, unixMicros());
+    }
+    largest = std::max(largest, payload.size());
+    publish(stateTopic(topicClass, sensors(random)), payload, false);
+    ++sent;
+
+    // PUBACKs and PINGRESPs are not needed, but must not pile up in the socket
+    while (publisher.receive(drain, sizeof(drain)) > 0)
+    {
+    }
+    if (!publisher.isOpen())
+    {
+      fprintf(stderr, "broker closed the connection after %zu messages\n", i);
+      break;
+    }
+    ping(publisher, lastPing);
+
+    const auto now = Clock::now();
+    if (options.burstEvery > 0 && now - lastBurst > std::chrono::duration<double>(options.burstEvery))
+    {
+      publishDiscovery(false);
+      lastBurst = now;
+    }
+    if (now - lastReport >= std::chrono::seconds(1))
+    {
+      printf("%5.1f s: %zu msg/s sent, %zu received by the probe\n", std::chrono::duration<double>(now - start).count(),
+             sent - sentAtReport, probe.messages());
+      sentAtReport = sent;
+      lastReport = now;
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  if (discoveryPublished)
+  {
+    publishDiscovery(true);
+  }
+  auto disconnect = MqttPacket::packet(MqttPacket::Disconnect << 4, {});
+  publisher.send(disconnect.data(), disconnect.size());
+  printf("sent %zu messages in %.2f s (%.0f msg/s, target %.0f), %zu sent over 100 ms late, %.1f MB, largest payload %zu B\n",
+         sent, seconds, sent / seconds, options.rate, late, bytesSent / 1e6, largest);
+  if (options.stamp)
+  {
+    probe.finish(sent);
+    std::vector<uint32_t> latencies = probe.takeLatencies();
+    printf("probe received %zu (%.1f%%); broker latency p50 %.0f us, p99 %.0f us, max %.0f us\n", probe.messages(),
+           100.0 * probe.messages() / (sent ? sent : 1), percentile(latencies, 0.5), percentile(latencies, 0.99),
+           latencies.empty() ? 0.0 : (double)*std::max_element(latencies.begin(), latencies.end()));
+  }
+  return 0;
+}
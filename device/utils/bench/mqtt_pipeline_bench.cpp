@@ -0,0 +1,210 @@
+// Host run of the receive -> dispatch -> store -> label pipeline over a Transport.
+// Build: g++ -std=c++17 -O2 -I../../include -I<ArduinoJson>/src mqtt_pipeline_bench.cpp -o mqtt_pipeline_bench
+// Run:   ./mqtt_pipeline_bench                  in-process loopback with FakeBroker
+//        ./mqtt_pipeline_bench localhost 1883   against a real broker (utils/mosquitto)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FakeBroker.h"
+#include "LoopbackTransport.h"
+#include "MQTTDispatcher.h"
+#include "MqttPacket.h"
+#include "PosixTransport.h"
+#include "SensorRegistry.h"
+#include "SensorStore.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t sensorCount = SensorRegistry::Capacity;
+static const size_t frameEvery = 64; // Messages between simulated UI frames
+static char labels[SensorRegistry::Capacity][24]; // Stand-in for the LVGL labels
+
+// The device side: what PubSubClient, MQTTDispatcher and render_dirty_sensors() do in main.cpp
+struct Device
+{
+  Transport& transport;
+  MqttPacket::Reader reader;
+  MQTTDispatcher dispatcher;
+  SensorRegistry registry;
+  SensorStore<SensorRegistry::Capacity> store;
+  size_t messages = 0;
+  size_t frames = 0;
+  size_t labelWrites = 0;
+
+  explicit Device(Transport& transport) : transport(transport)
+  {
+    for (size_t i = 0; i < sensorCount; ++i)
+    {
+      registry.registerSensor("homeassistant/sensor/bench_" + std::to_string(i) + "/state", "bench", "°C", "temperature");
+    }
+    dispatcher.registerValueHandler("homeassistant/sensor/#", [this](const std::string& topic, const ParsedPayload& value)
+    {
+      uint8_t slot = registry.find(topic);
+      if (slot == SensorRegistry::NoSlot || value.kind != ParsedPayload::Number)
+      {
+        dispatcher.ignore();
+        return;
+      }
+      store.update(slot, (float)value.value, (uint32_t)messages, 0);
+    });
+  }
+
+  bool connect(const char* host, uint16_t port)
+  {
+    if (!transport.open(host, port))
+    {
+      return false;
+    }
+    send(MqttPacket::connect("pipeline-bench", "", "", 60, true));
+    std::vector<std::string> filters;
+    for (const auto& subscription : dispatcher.subscriptions())
+    {
+      filters.push_back(subscription.filter);
+    }
+    send(MqttPacket::subscribe(1, filters, 0));
+    return true;
+  }
+
+  void send(const std::vector<uint8_t>& bytes)
+  {
+    transport.send(bytes.data(), bytes.size());
+  }
+
+  // Returns the number of bytes read
+  size_t poll()
+  {
+    uint8_t buffer[1024];
+    size_t total = 0;
+    int n;
+    while ((n = transport.receive(buffer, sizeof(buffer))) > 0)
+    {
+      total += n;
+      size_t offset = 0;
+      while (offset < (size_t)n)
+      {
+        offset += reader.feed(buffer + offset, n - offset);
+        MqttPacket::PublishView view;
+        if (reader.complete() && MqttPacket::parsePublish(reader, view))
+        {
+          dispatcher.dispatch(view.topic, std::string((const char*)view.payload, view.length));
+          if (++messages % frameEvery == 0)
+          {
+            render();
+          }
+        }
+      }
+    }
+    return total;
+  }
+
+  void render()
+  {
+    ++frames;
+    store.forEachDirty([this](size_t slot)
+    {
+      snprintf(labels[slot], sizeof(labels[slot]), "%.1f %s", store.value(slot), registry.info(slot).unit);
+      ++labelWrites;
+    });
+  }
+};
+
+static std::string topicOf(size_t i)
+{
+  // Every fourth message is for a sensor nobody discovered, like real HA traffic
+  return "homeassistant/sensor/" + std::string(i % 4 == 3 ? "other_" : "bench_") + std::to_string(i % sensorCount) + "/state";
+}
+
+static std::string payloadOf(size_t i)
+{
+  char payload[16];
+  snprintf(payload, sizeof(payload), "%.2f", 15 + (i % 1000) / 100.0);
+  return payload;
+}
+
+static void report(const char* name, Device& device, size_t sent, double seconds)
+{
+  const auto& filter = device.dispatcher.subscriptions()[0];
+  printf("%s: %zu/%zu messages in %.3f s, %.0f msg/s, %.0f ns/msg\n", name, device.messages, sent, seconds,
+         device.messages / seconds, seconds * 1e9 / (device.messages ? device.messages : 1));
+  printf("  %zu frames, %zu label writes; filter %s received %u, used %u\n", device.frames, device.labelWrites,
+         filter.filter.c_str(), (unsigned)filter.received, (unsigned)filter.used);
+}
+
+static void runLoopback(size_t count)
+{
+  LoopbackLink link;
+  FakeBroker broker(link.server());
+  Device device(link.client());
+  device.connect("loopback", 1883);
+  broker.poll();
+  device.poll();
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; ++i)
+  {
+    broker.publish(topicOf(i), payloadOf(i));
+    if (i % frameEvery == frameEvery - 1)
+    {
+      device.poll();
+    }
+  }
+  device.poll();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  report("loopback", device, count, seconds);
+}
+
+static void runBroker(const char* host, uint16_t port, size_t count)
+{
+  PosixTransport subscriberTransport;
+  Device device(subscriberTransport);
+  if (!device.connect(host, port))
+  {
+    fprintf(stderr, "cannot connect to %s:%u\n", host, port);
+    exit(1);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  device.poll();
+
+  PosixTransport publisher;
+  publisher.open(host, port);
+  auto connect = MqttPacket::connect("pipeline-bench-pub", "", "", 60, true);
+  publisher.send(connect.data(), connect.size());
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; ++i)
+  {
+    std::string payload = payloadOf(i);
+    auto packet = MqttPacket::publish(topicOf(i), (const uint8_t*)payload.data(), payload.size(), 0, false, 0);
+    publisher.send(packet.data(), packet.size());
+    device.poll();
+  }
+
+  // Drain until everything arrived or the broker goes quiet
+  auto lastProgress = Clock::now();
+  while (device.messages < count && Clock::now() - lastProgress < std::chrono::seconds(2))
+  {
+    if (device.poll() > 0)
+    {
+      lastProgress = Clock::now();
+    }
+  }
+  double seconds = std::chrono::duration<double>(lastProgress - start).count();
+  report("broker", device, count, seconds);
+}
+
+int main(int argc, char** argv)
+{
+  const size_t count = 200000;
+  if (argc >= 3)
+  {
+    runBroker(argv[1], (uint16_t)atoi(argv[2]), count / 10);
+  }
+  else
+  {
+    runLoopback(count);
+  }
+  return 0;
+}
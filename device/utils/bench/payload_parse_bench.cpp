@@ -0,0 +1,70 @@
+// Host benchmark for parsePayload() against the C library parsers.
+// Build: g++ -std=c++17 -O2 -I../../include payload_parse_bench.cpp -o payload_parse_bench
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "PayloadParser.h"
+
+using Clock = std::chrono::steady_clock;
+
+// A mix resembling Home Assistant sensor state traffic
+static const char *samples[] = {
+  "21.5", "-3", "1013.25", "unavailable", "45", "0.001", "1234567", "unknown",
+  "19.87", "100", "-12.25", "3.3", "65535", "0", "22.125", "on",
+};
+
+int main()
+{
+  std::vector<std::string> payloads;
+  for (size_t i = 0; i < 4096; ++i)
+  {
+    payloads.push_back(samples[i % (sizeof(samples) / sizeof(samples[0]))]);
+  }
+
+  const size_t rounds = 2000;
+  const size_t total = rounds * payloads.size();
+  size_t bytes = 0;
+  for (const auto& payload : payloads)
+  {
+    bytes += payload.size();
+  }
+
+  double sink = 0;
+  auto start = Clock::now();
+  for (size_t round = 0; round < rounds; ++round)
+  {
+    for (const auto& payload : payloads)
+    {
+      ParsedPayload parsed = parsePayload(payload.data(), payload.size());
+      sink += parsed.value;
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("parsePayload: %7.1f ns/msg  %7.1f MB/s\n", seconds * 1e9 / total, bytes * rounds / seconds / 1e6);
+
+  start = Clock::now();
+  for (size_t round = 0; round < rounds; ++round)
+  {
+    for (const auto& payload : payloads)
+    {
+      sink += strtof(payload.c_str(), nullptr);
+    }
+  }
+  seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("strtof:       %7.1f ns/msg  %7.1f MB/s\n", seconds * 1e9 / total, bytes * rounds / seconds / 1e6);
+
+  start = Clock::now();
+  for (size_t round = 0; round < rounds; ++round)
+  {
+    for (const auto& payload : payloads)
+    {
+      sink += atof(payload.c_str());
+    }
+  }
+  seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("atof:         %7.1f ns/msg  %7.1f MB/s\n", seconds * 1e9 / total, bytes * rounds / seconds / 1e6);
+
+  return sink == 0.5 ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+// Messages a device receives right after reconnecting (main.cpp's mqtt_reconnect_burst), by
+// session and subscription QoS, against FakeBroker's model of mosquitto's persistent sessions.
+// Build: g++ -std=c++17 -O2 -I../../include reconnect_burst_bench.cpp -o reconnect_burst_bench
+// Run:   ./reconnect_burst_bench [sensors] [offline minutes] [updates per sensor per minute]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "FakeBroker.h"
+#include "LoopbackTransport.h"
+#include "MQTTDispatcher.h"
+#include "MqttPacket.h"
+
+static const char* devicePrefix = "cyd/cyd_a1b2c3d4e5f6/";
+
+// The device's covering filters, from the same registrations main.cpp makes
+static std::vector<std::string> deviceFilters()
+{
+  MQTTDispatcher dispatcher;
+  const Handler none = [](const std::string&, const std::string&) {};
+  dispatcher.registerHandler("home/livingroom/temperature", none);
+  dispatcher.registerHandler("homeassistant/sensor/+/config", none);
+  dispatcher.registerHandler("homeassistant/sensor/+/+/config", none);
+  dispatcher.registerHandler("homeassistant/sensor/#", none);
+  dispatcher.registerHandler(std::string(devicePrefix) + "alerts/config", none);
+  dispatcher.registerHandler(std::string(devicePrefix) + "memory/config", none);
+  dispatcher.registerHandler(std::string(devicePrefix) + "log/export", none);
+  std::vector<std::string> filters;
+  for (const auto& subscription : dispatcher.subscriptions())
+  {
+    filters.push_back(subscription.filter);
+  }
+  return filters;
+}
+
+// PUBLISH packets waiting at the client end of the link; `command` notes the offline command
+static size_t drain(LoopbackLink& link, bool& command)
+{
+  MqttPacket::Reader reader;
+  uint8_t buffer[1024];
+  size_t messages = 0;
+  int n;
+  while ((n = link.client().receive(buffer, sizeof(buffer))) > 0)
+  {
+    size_t offset = 0;
+    while (offset < (size_t)n)
+    {
+      offset += reader.feed(buffer + offset, n - offset);
+      MqttPacket::PublishView view;
+      if (reader.complete() && MqttPacket::parsePublish(reader, view))
+      {
+        ++messages;
+        command = command || view.topic == std::string(devicePrefix) + "log/export";
+      }
+    }
+  }
+  return messages;
+}
+
+struct Scenario
+{
+  const char* name;
+  bool cleanSession;
+  bool wildcardQos1; // homeassistant/sensor/# at QoS 1 as well as the cyd/<device>/ commands
+};
+
+int main(int argc, char** argv)
+{
+  const size_t sensors = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200;
+  const size_t offlineMinutes = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10;
+  const size_t updatesPerMinute = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1;
+  const std::vector<std::string> filters = deviceFilters();
+
+  printf("%zu sensors, offline %zu min, %zu update(s)/sensor/min at QoS 1, one command sent while offline\n", sensors,
+         offlineMinutes, updatesPerMinute);
+  const Scenario scenarios[] = {
+    {"clean session, resubscribe", true, false},
+    {"persistent, all filters QoS 1", false, true},
+    {"persistent, commands QoS 1", false, false},
+  };
+  for (const auto& scenario : scenarios)
+  {
+    LoopbackLink link;
+    FakeBroker broker(link.server(), 1000); // max_queued_messages in utils/mosquitto
+    for (size_t i = 0; i < sensors; ++i)
+    {
+      broker.publish("homeassistant/sensor/bench_" + std::to_string(i) + "/config", "{\"stat_t\":\"...\"}", true);
+    }
+    broker.publish(std::string(devicePrefix) + "alerts/config", "{\"rules\":[]}", true);
+    broker.publish(std::string(devicePrefix) + "memory/config", "{}", true);
+
+    std::vector<uint8_t> qos;
+    for (const auto& filter : filters)
+    {
+      qos.push_back(filter.compare(0, strlen(devicePrefix), devicePrefix) == 0 || scenario.wildcardQos1 ? 1 : 0);
+    }
+    auto send = [&link](const std::vector<uint8_t>& bytes) { link.client().send(bytes.data(), bytes.size()); };
+
+    // First connect of the boot always subscribes
+    bool command = false;
+    link.client().open("broker", 1883);
+    send(MqttPacket::connect("cyd-bench", "", "", 60, scenario.cleanSession));
+    send(MqttPacket::subscribe(1, filters, qos));
+    broker.poll();
+    const size_t initial = drain(link, command);
+
+    link.client().close();
+    for (size_t minute = 0; minute < offlineMinutes; ++minute)
+    {
+      for (size_t update = 0; update < updatesPerMinute; ++update)
+      {
+        for (size_t i = 0; i < sensors; ++i)
+        {
+          broker.publish("homeassistant/sensor/bench_" + std::to_string(i) + "/state", std::to_string(minute), false, 1);
+        }
+      }
+    }
+    broker.publish(std::string(devicePrefix) + "log/export", "", false, 1);
+
+    // Reconnect: a resumed session keeps its subscriptions, as main.cpp assumes
+    command = false;
+    link.client().open("broker", 1883);
+    send(MqttPacket::connect("cyd-bench", "", "", 60, scenario.cleanSession));
+    if (scenario.cleanSession)
+    {
+      send(MqttPacket::subscribe(2, filters, qos));
+    }
+    broker.poll();
+    const size_t burst = drain(link, command);
+    printf("%-30s first connect %5zu  reconnect burst %5zu  offline command %-8s  broker queue overflow %zu\n", scenario.name,
+           initial, burst, command ? "received" : "lost", broker.queueOverflow());
+  }
+  return 0;
+}
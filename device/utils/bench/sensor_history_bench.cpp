@@ -0,0 +1,61 @@
+// Host benchmark for SensorHistory add() cost, after checking that buckets keep closing across
+// a millis() wrap (through UptimeClock, as main.cpp feeds it) and after a clock jump backwards.
+// Build: g++ -std=c++17 -O2 -I../../include sensor_history_bench.cpp -o sensor_history_bench
+#include <chrono>
+#include <cstdio>
+#include "SensorHistory.h"
+
+using Clock = std::chrono::steady_clock;
+
+static SensorHistory<> history;
+
+// Minute buckets closed by one sample a second over `minutes`, millis() starting at `startMs`
+static size_t minutesClosedFrom(uint32_t startMs, uint32_t minutes)
+{
+  history.clear();
+  UptimeClock clock;
+  clock.seconds(startMs); // As at boot, long before the wrap
+  size_t closed = 0;
+  for (uint32_t second = 0; second < minutes * 60; ++second)
+  {
+    const uint32_t nowMs = startMs + second * 1000; // Wraps like millis()
+    closed += (history.add(20.0f, clock.seconds(nowMs)) & history.closed(history.Minute)) != 0;
+  }
+  return closed;
+}
+
+int main()
+{
+  const size_t steady = minutesClosedFrom(1000, 20);
+  const size_t acrossWrap = minutesClosedFrom(UINT32_MAX - 10 * 60 * 1000, 20);
+  printf("minute buckets closed over 20 min: %zu, across the millis() wrap: %zu\n", steady, acrossWrap);
+  if (steady < 19 || acrossWrap != steady)
+  {
+    fprintf(stderr, "buckets stopped closing across the wrap\n");
+    return 1;
+  }
+
+  // A clock that jumps back (raw millis() / 1000 at the wrap) restarts the history instead of freezing it
+  history.clear();
+  history.add(20.0f, 4294960);
+  history.add(20.0f, 4294970);
+  const bool restarted = history.add(21.0f, 5) & history.closed(history.Minute);
+  history.add(21.0f, 65);
+  if (!restarted || history.minuteBuckets().size() != 1 || history.minuteBuckets()[0].average() != 21.0f)
+  {
+    fprintf(stderr, "history froze after the clock went backwards\n");
+    return 1;
+  }
+  printf("clock jump backwards: history restarted\n");
+
+  const size_t samples = 50'000'000;
+  history.clear();
+  const auto start = Clock::now();
+  for (size_t i = 0; i < samples; ++i)
+  {
+    history.add((float)(i & 31), (uint32_t)(i / 8)); // Eight samples a second
+  }
+  const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+  printf("add: %.2f ns/sample, %zu minute buckets held\n", ns, history.minuteBuckets().size());
+  return 0;
+}
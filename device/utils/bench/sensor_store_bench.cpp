@@ -0,0 +1,66 @@
+// Host benchmark for SensorStore update, dirty-scan and snapshot cost.
+// Build: g++ -std=c++17 -O2 -I../../include sensor_store_bench.cpp -o sensor_store_bench
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "SensorStore.h"
+
+static constexpr size_t SensorCount = 1000;
+
+using Clock = std::chrono::steady_clock;
+
+static double nsPerOp(Clock::time_point start, size_t ops)
+{
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+}
+
+int main()
+{
+  static SensorStore<SensorCount> store;
+  static SensorStore<SensorCount>::Snapshot snapshot;
+
+  std::mt19937 rng(42);
+  std::vector<uint16_t> slots(1 << 16);
+  for (auto& slot : slots)
+  {
+    slot = rng() % SensorCount;
+  }
+
+  const size_t updates = 10'000'000;
+  auto start = Clock::now();
+  for (size_t i = 0; i < updates; ++i)
+  {
+    store.update(slots[i & 0xFFFF], (float)i, (uint32_t)i, 0);
+  }
+  printf("update:               %6.2f ns/op\n", nsPerOp(start, updates));
+
+  // Scan cost with a realistic handful of dirty slots per frame, and with all of them dirty
+  for (size_t dirtyPerFrame : {size_t(0), size_t(1), size_t(10), size_t(100), SensorCount})
+  {
+    const size_t frames = 200'000;
+    size_t visited = 0;
+    std::chrono::duration<double, std::nano> scanTime{0};
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+      for (size_t i = 0; i < dirtyPerFrame; ++i)
+      {
+        store.update(slots[(frame * dirtyPerFrame + i) & 0xFFFF], 1.0f, 0, 0);
+      }
+      auto scanStart = Clock::now();
+      store.forEachDirty([&](size_t) { ++visited; });
+      scanTime += Clock::now() - scanStart;
+    }
+    printf("scan (%4zu dirty):     %8.1f ns/frame (%zu visits)\n", dirtyPerFrame, scanTime.count() / frames, visited);
+  }
+
+  const size_t snapshots = 200'000;
+  start = Clock::now();
+  for (size_t i = 0; i < snapshots; ++i)
+  {
+    store.snapshot(snapshot);
+  }
+  printf("snapshot:             %8.1f ns/op\n", nsPerOp(start, snapshots));
+
+  return snapshot.sequence == 1 ? 1 : 0;
+}
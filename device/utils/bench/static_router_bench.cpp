@@ -0,0 +1,159 @@
+// Host benchmark for the compile-time StaticRouting::Router against the runtime MQTTDispatcher,
+// both holding the routes main.cpp registers for its fixed topics plus the per-device ones.
+// Build: g++ -std=c++17 -O2 -I../../include static_router_bench.cpp -o static_router_bench
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "MQTTDispatcher.h"
+#include "StaticRouter.h"
+
+using Clock = std::chrono::steady_clock;
+
+// What the handlers saw, compared between the two routers
+struct Counts
+{
+  size_t local = 0;
+  size_t configs = 0;
+  size_t states = 0;
+  size_t device = 0;
+  double sum = 0;
+};
+
+static Counts counts;
+
+static void onLocal(const std::string&, const ParsedPayload& value)
+{
+  ++counts.local;
+  counts.sum += value.value;
+}
+
+static void onConfig(const std::string& topic, const std::string& json)
+{
+  ++counts.configs;
+  counts.sum += (double)(topic.size() + json.size());
+}
+
+static void onState(const std::string&, const ParsedPayload& value)
+{
+  ++counts.states;
+  counts.sum += value.kind == ParsedPayload::Number ? value.value : 0;
+}
+
+static void onDevice(const std::string&, const std::string& payload)
+{
+  ++counts.device;
+  counts.sum += (double)payload.size();
+}
+
+// Wildcards are checked while compiling: "homeassistant/sensor/#/state" here is a build error
+static constexpr auto router = StaticRouting::makeRouter(
+  StaticRouting::route("home/livingroom/temperature", [](const std::string& t, const ParsedPayload& v) { onLocal(t, v); }),
+  StaticRouting::route("homeassistant/sensor/+/config", [](const std::string& t, const std::string& p) { onConfig(t, p); }),
+  StaticRouting::route("homeassistant/sensor/+/+/config", [](const std::string& t, const std::string& p) { onConfig(t, p); }),
+  StaticRouting::route("homeassistant/sensor/#", [](const std::string& t, const ParsedPayload& v) { onState(t, v); }),
+  StaticRouting::route("cyd/bench/alerts/config", [](const std::string& t, const std::string& p) { onDevice(t, p); }),
+  StaticRouting::route("cyd/bench/memory/config", [](const std::string& t, const std::string& p) { onDevice(t, p); }),
+  StaticRouting::route("cyd/bench/log/export", [](const std::string& t, const std::string& p) { onDevice(t, p); }));
+
+static_assert(router.size() == 7, "every route is in the table");
+static_assert(StaticRouting::Pattern("homeassistant/sensor/+/+/config").levels() == 5, "levels are split at compile time");
+
+// Resembles HA traffic: mostly single-sensor state updates, some node-style states,
+// the odd discovery config, device commands and topics nobody handles
+static std::vector<std::string> makeTopics(size_t count)
+{
+  static const char* objects[] = {"living_room_temperature", "kitchen_humidity", "outdoor_pressure", "garage_door_battery",
+                                  "bedroom_co2", "office_illuminance", "washing_machine_power", "heat_pump_flow_temperature"};
+  static const char* nodes[] = {"zigbee2mqtt_0x00158d0001a2b3c4", "shelly_plus_1pm_a8032ab1", "esphome_weather_station"};
+  std::vector<std::string> topics;
+  srand(49);
+  for (size_t i = 0; i < count; ++i)
+  {
+    const int roll = rand() % 100;
+    const char* object = objects[rand() % 8];
+    if (roll < 60)
+    {
+      topics.push_back(std::string("homeassistant/sensor/") + object + "/state");
+    }
+    else if (roll < 80)
+    {
+      topics.push_back(std::string("homeassistant/sensor/") + nodes[rand() % 3] + "/" + object + "/state");
+    }
+    else if (roll < 85)
+    {
+      topics.push_back(std::string("homeassistant/sensor/") + object + "/config");
+    }
+    else if (roll < 92)
+    {
+      topics.push_back("home/livingroom/temperature");
+    }
+    else if (roll < 96)
+    {
+      topics.push_back(rand() % 2 ? "cyd/bench/alerts/config" : "cyd/bench/log/export");
+    }
+    else
+    {
+      topics.push_back(std::string("zigbee2mqtt/") + object + "/availability");
+    }
+  }
+  return topics;
+}
+
+template <typename Dispatch>
+static double run(const char* name, const std::vector<std::string>& topics, const std::vector<std::string>& payloads, size_t rounds,
+                  Dispatch dispatch)
+{
+  counts = Counts();
+  const auto start = Clock::now();
+  for (size_t round = 0; round < rounds; ++round)
+  {
+    for (size_t i = 0; i < topics.size(); ++i)
+    {
+      dispatch(topics[i], payloads[i]);
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  const double ns = seconds * 1e9 / (rounds * topics.size());
+  printf("%-15s %7.1f ns/msg  local %zu  configs %zu  states %zu  device %zu\n", name, ns, counts.local, counts.configs,
+         counts.states, counts.device);
+  return ns;
+}
+
+int main()
+{
+  const std::vector<std::string> topics = makeTopics(4096);
+  std::vector<std::string> payloads;
+  static const char* samples[] = {"21.5", "-3", "1013.25", "unavailable", "45", "0.001", "on", "{\"name\":\"x\"}"};
+  for (size_t i = 0; i < topics.size(); ++i)
+  {
+    payloads.push_back(samples[i % 8]);
+  }
+
+  MQTTDispatcher dispatcher;
+  dispatcher.registerValueHandler("home/livingroom/temperature", onLocal);
+  dispatcher.registerHandler("homeassistant/sensor/+/config", onConfig);
+  dispatcher.registerHandler("homeassistant/sensor/+/+/config", onConfig);
+  dispatcher.registerValueHandler("homeassistant/sensor/#", onState);
+  dispatcher.registerHandler("cyd/bench/alerts/config", onDevice);
+  dispatcher.registerHandler("cyd/bench/memory/config", onDevice);
+  dispatcher.registerHandler("cyd/bench/log/export", onDevice);
+  dispatcher.subscriptions();
+
+  const size_t rounds = 500;
+  const double runtime = run("MQTTDispatcher", topics, payloads, rounds,
+                             [&dispatcher](const std::string& t, const std::string& p) { dispatcher.dispatch(t, p); });
+  const Counts expected = counts;
+  const double compiled = run("StaticRouter", topics, payloads, rounds,
+                              [](const std::string& t, const std::string& p) { router.dispatch(t, p); });
+
+  if (counts.local != expected.local || counts.configs != expected.configs || counts.states != expected.states ||
+      counts.device != expected.device)
+  {
+    fprintf(stderr, "routers disagree\n");
+    return 1;
+  }
+  printf("static table: %zu bytes, no heap; %.2fx faster\n", sizeof(router), runtime / compiled);
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Host benchmark for TimeSeriesLog over a file-backed block device: append and
+// export throughput, erase distribution, and flash endurance at the firmware's
+// flush interval for a range of received message rates.
+// Build: g++ -std=c++17 -O2 -I../../include timeseries_log_bench.cpp -o timeseries_log_bench
+// Usage: ./timeseries_log_bench [image-file] [records]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "TimeSeriesLog.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Same geometry as the device: 64 segments x 8 pages x 512 B
+static constexpr uint16_t Segments = 64;
+static constexpr uint16_t PagesPerSegment = 8;
+
+// Typical NOR flash erase endurance
+static constexpr double EraseCycles = 100000;
+
+// main.cpp's loop() flushes the sensor log this often
+static constexpr uint32_t FlushSeconds = 5 * 60;
+
+int main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : "timeseries_log_bench.img";
+  const uint32_t records = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 5'000'000;
+  remove(path);
+
+  FileLogStorage storage(path, Segments, PagesPerSegment);
+  TimeSeriesLog log(storage);
+  log.begin();
+
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < records; ++i)
+  {
+    log.append(i % 32, i, (float)i * 0.1f);
+  }
+  log.flush();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  const auto &stats = log.statistics();
+  printf("append:  %u records in %.2f s, %.0f records/s, %u pages, %u erases\n",
+         records, seconds, records / seconds, stats.pagesWritten, stats.segmentsErased);
+
+  start = Clock::now();
+  TimeSeriesLog::Cursor cursor = log.beginExport();
+  LogRecord page[TimeSeriesLog::RecordsPerPage];
+  size_t exported = 0;
+  size_t count;
+  while ((count = log.exportNext(cursor, page)) > 0)
+  {
+    exported += count;
+  }
+  seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("export:  %zu records in %.3f s, %.0f records/s\n", exported, seconds, exported / seconds);
+
+  const auto &erases = storage.eraseCounts();
+  const auto [least, most] = std::minmax_element(erases.begin(), erases.end());
+  printf("wear:    erases per segment min %u max %u\n", *least, *most);
+
+  // The shipped configuration: every received value is appended and loop() flushes the
+  // pending (usually partial) page every 5 minutes. One simulated day per message rate.
+  const double ringPages = (double)Segments * PagesPerSegment;
+  for (double perSecond : {0.05, 1.0, 10.0, 100.0})
+  {
+    remove(path);
+    FileLogStorage dayStorage(path, Segments, PagesPerSegment);
+    TimeSeriesLog dayLog(dayStorage);
+    dayLog.begin();
+    double due = 0;
+    for (uint32_t flush = 0; flush < 24 * 12; ++flush)
+    {
+      for (due += perSecond * FlushSeconds; due >= 1; --due)
+      {
+        dayLog.append(0, flush * FlushSeconds, 0.0f);
+      }
+      dayLog.flush();
+    }
+    const auto &day = dayLog.statistics();
+    const double erasesPerDay = day.pagesWritten / ringPages; // Per segment, the ring wears them evenly
+    printf("endurance: %6.2f msg/s -> %5u pages/day, %4.1f records/page, %.1f years to %.0f erase cycles\n", perSecond,
+           day.pagesWritten, (double)day.recordsAppended / day.pagesWritten, EraseCycles / erasesPerDay / 365, EraseCycles);
+  }
+
+  remove(path);
+  return 0;
+}
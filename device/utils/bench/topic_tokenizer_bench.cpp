@@ -0,0 +1,141 @@
+// Host benchmark for TopicTokenizer: byte-at-a-time against word-at-a-time (the path the
+// ESP32 takes) and SSE2/NEON, over HA topic lengths. Every variant is checked against the
+// bytewise reference first, at every alignment.
+// Build: g++ -std=c++17 -O2 -I../../include topic_tokenizer_bench.cpp -o topic_tokenizer_bench
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "TopicTokenizer.h"
+
+using Clock = std::chrono::steady_clock;
+using Tokenize = TopicTokenizer::Levels (*)(const char*, size_t);
+
+static bool same(const TopicTokenizer::Levels& a, const TopicTokenizer::Levels& b)
+{
+  if (a.count != b.count || a.truncated != b.truncated)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < a.count; ++i)
+  {
+    if (a.start[i] != b.start[i] || a.length[i] != b.length[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Topics shaped like a Home Assistant install: short and long object ids,
+// node-style topics, zigbee2mqtt device names and the odd very deep topic
+static std::vector<std::string> makeTopics(size_t count)
+{
+  static const char* objects[] = {"temp", "kitchen_humidity", "living_room_temperature", "washing_machine_power_consumption",
+                                  "heat_pump_flow_temperature_setpoint", "co2"};
+  static const char* nodes[] = {"zigbee2mqtt_0x00158d0001a2b3c4", "shelly_plus_1pm_a8032ab1", "esp"};
+  std::vector<std::string> topics;
+  srand(50);
+  for (size_t i = 0; i < count; ++i)
+  {
+    const int roll = rand() % 100;
+    const char* object = objects[rand() % 6];
+    if (roll < 55)
+    {
+      topics.push_back(std::string("homeassistant/sensor/") + object + "/state");
+    }
+    else if (roll < 80)
+    {
+      topics.push_back(std::string("homeassistant/sensor/") + nodes[rand() % 3] + "/" + object + "/state");
+    }
+    else if (roll < 90)
+    {
+      topics.push_back(std::string("zigbee2mqtt/") + object);
+    }
+    else if (roll < 98)
+    {
+      topics.push_back("home/livingroom/temperature");
+    }
+    else
+    {
+      topics.push_back("a/b/c/d/e/f/g/h/i/j/k/l/m/n/o/p/q/r/s"); // Deeper than Capacity
+    }
+  }
+  return topics;
+}
+
+static bool verify(const char* name, Tokenize tokenize, const std::vector<std::string>& topics)
+{
+  static const char* edges[] = {"", "/", "//", "a", "a/", "/a", "a//b", "////////////////////", "0123456789abcdef/0123456789abcdef",
+                                "x/x/x/x/x/x/x/x/x/x/x/x/x/x/x/x", "x/x/x/x/x/x/x/x/x/x/x/x/x/x/x/x/x"};
+  std::vector<std::string> cases(topics.begin(), topics.begin() + 64);
+  cases.insert(cases.end(), edges, edges + sizeof(edges) / sizeof(edges[0]));
+  char buffer[256];
+  for (const auto& topic : cases)
+  {
+    for (size_t offset = 0; offset < 16; ++offset)
+    {
+      memcpy(buffer + offset, topic.data(), topic.size());
+      const auto expected = TopicTokenizer::bytewise(buffer + offset, topic.size());
+      if (!same(tokenize(buffer + offset, topic.size()), expected))
+      {
+        fprintf(stderr, "%s disagrees on \"%s\" at offset %zu\n", name, topic.c_str(), offset);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void run(const char* name, Tokenize tokenize, const std::vector<std::string>& topics, size_t rounds, size_t bytes)
+{
+  size_t sink = 0;
+  const auto start = Clock::now();
+  for (size_t round = 0; round < rounds; ++round)
+  {
+    for (const auto& topic : topics)
+    {
+      const auto levels = tokenize(topic.data(), topic.size());
+      sink += levels.count + levels.length[levels.count - 1];
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-10s %6.1f ns/topic  %7.1f MB/s  (%zu)\n", name, seconds * 1e9 / (rounds * topics.size()),
+         bytes * rounds / seconds / 1e6, sink % 10);
+}
+
+int main()
+{
+  const std::vector<std::string> topics = makeTopics(4096);
+  size_t bytes = 0;
+  for (const auto& topic : topics)
+  {
+    bytes += topic.size();
+  }
+  printf("%zu topics, %.1f bytes on average\n", topics.size(), (double)bytes / topics.size());
+
+  struct Variant
+  {
+    const char* name;
+    Tokenize tokenize;
+  };
+  std::vector<Variant> variants = {{"bytewise", TopicTokenizer::bytewise}, {"wordwise", TopicTokenizer::wordwise}};
+#if defined(__SSE2__) || defined(__ARM_NEON)
+  variants.push_back({"vectorwise", TopicTokenizer::vectorwise});
+#endif
+
+  for (const auto& variant : variants)
+  {
+    if (!verify(variant.name, variant.tokenize, topics))
+    {
+      return 1;
+    }
+  }
+  for (const auto& variant : variants)
+  {
+    run(variant.name, variant.tokenize, topics, 2000, bytes);
+  }
+  return 0;
+}
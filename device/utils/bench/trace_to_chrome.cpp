@@ -0,0 +1,158 @@
+// Converts a main loop trace dump (include/TraceRing.h, firmware built with -D CYD_TRACE)
+// into Chrome trace_event JSON for chrome://tracing or https://ui.perfetto.dev.
+// Build: g++ -std=c++17 -O2 -I../../include trace_to_chrome.cpp -o trace_to_chrome
+// Run:   mosquitto_sub -h localhost -t 'cyd/<device>/trace/data' -C 1 > trace.bin &
+//        mosquitto_pub -h localhost -t 'cyd/<device>/trace/dump' -n
+//        ./trace_to_chrome trace.bin > trace.json
+//    or: type "trace" in the serial monitor, save the log, ./trace_to_chrome monitor.log > trace.json
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "TraceRing.h"
+
+static std::vector<uint8_t> readFile(const char* path)
+{
+  std::vector<uint8_t> bytes;
+  FILE* file = fopen(path, "rb");
+  if (!file)
+  {
+    return bytes;
+  }
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  fclose(file);
+  return bytes;
+}
+
+// The last complete "TRACE <hex>" ... "TRACE END" block of a serial log
+static std::vector<uint8_t> fromSerialLog(const std::vector<uint8_t>& log)
+{
+  std::vector<uint8_t> current, complete;
+  size_t start = 0;
+  while (start < log.size())
+  {
+    size_t end = start;
+    while (end < log.size() && log[end] != '\n')
+    {
+      ++end;
+    }
+    std::string line((const char*)log.data() + start, end - start);
+    start = end + 1;
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+    {
+      line.pop_back();
+    }
+    const size_t at = line.find("TRACE ");
+    if (at == std::string::npos)
+    {
+      continue;
+    }
+    const std::string hex = line.substr(at + 6);
+    if (hex == "END")
+    {
+      complete.swap(current);
+      current.clear();
+      continue;
+    }
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    {
+      current.push_back((uint8_t)strtoul(hex.substr(i, 2).c_str(), nullptr, 16));
+    }
+  }
+  return complete;
+}
+
+static std::string eventName(const Trace::Event& event)
+{
+  return event.point == Trace::Handler ? "handler #" + std::to_string(event.arg) : Trace::name(event.point);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s dump.bin|serial.log > trace.json\n", argv[0]);
+    return 2;
+  }
+  std::vector<uint8_t> dump = readFile(argv[1]);
+  if (dump.size() < 4 || memcmp(dump.data(), "CYDT", 4) != 0)
+  {
+    dump = fromSerialLog(dump);
+  }
+
+  Trace::DumpHeader header;
+  if (dump.size() < sizeof(header) || memcmp(dump.data(), "CYDT", 4) != 0)
+  {
+    fprintf(stderr, "%s holds no trace dump\n", argv[1]);
+    return 1;
+  }
+  memcpy(&header, dump.data(), sizeof(header));
+  if (header.version != 1 || header.eventSize != sizeof(Trace::Event) || header.ticksPerUs == 0 ||
+      dump.size() < sizeof(header) + (size_t)header.count * sizeof(Trace::Event))
+  {
+    fprintf(stderr, "unsupported or truncated dump (version %u, %u events)\n", header.version, (unsigned)header.count);
+    return 1;
+  }
+
+  std::vector<Trace::Event> events(header.count);
+  memcpy(events.data(), dump.data() + sizeof(header), events.size() * sizeof(Trace::Event));
+
+  // Ticks are 32 bits and wrap; events are in order, so a step backwards is a wrap
+  printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  std::vector<const Trace::Event*> open;
+  uint64_t base = 0;
+  uint32_t previous = events.empty() ? 0 : events[0].ticks;
+  double lastUs = 0;
+  bool first = true;
+  size_t dropped = 0;
+  auto emit = [&](const std::string& name, char phase, double us, const Trace::Event& event)
+  {
+    printf("%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1", first ? "" : ",\n", name.c_str(), phase, us);
+    if (event.point == Trace::Handler)
+    {
+      printf(",\"args\":{\"handler\":%u}", (unsigned)event.arg);
+    }
+    printf("}");
+    first = false;
+  };
+  for (const auto& event : events)
+  {
+    if (event.ticks < previous)
+    {
+      base += 1ull << 32;
+    }
+    previous = event.ticks;
+    lastUs = (double)(base + event.ticks - events[0].ticks) / header.ticksPerUs;
+
+    if (event.phase == 'B')
+    {
+      open.push_back(&event);
+    }
+    else if (open.empty() || open.back()->point != event.point)
+    {
+      ++dropped; // Its begin fell off the ring
+      continue;
+    }
+    else
+    {
+      open.pop_back();
+    }
+    emit(eventName(event), (char)event.phase, lastUs, event);
+  }
+  // Scopes still open when the dump was taken (the loop pass that sent it)
+  while (!open.empty())
+  {
+    emit(eventName(*open.back()), 'E', lastUs, *open.back());
+    open.pop_back();
+  }
+  printf("\n]}\n");
+  fprintf(stderr, "%u events over %.1f ms at %u ticks/us, %zu unmatched ends dropped\n", (unsigned)header.count, lastUs / 1000,
+          (unsigned)header.ticksPerUs, dropped);
+  return 0;
+}
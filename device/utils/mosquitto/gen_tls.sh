@@ -0,0 +1,34 @@
+#!/bin/sh
+# Creates a throwaway CA, a broker certificate and a PSK for the TLS listeners,
+# then enables them (8883 certificate, 8884 PSK). Restart the container afterwards.
+set -e
+cd "$(dirname "$0")/config"
+mkdir -p certs conf.d
+host=${1:-localhost}
+
+openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes -days 3650 \
+  -subj "/CN=cyd-mqtt test CA" -keyout certs/ca.key -out certs/ca.crt
+openssl req -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+  -subj "/CN=$host" -keyout certs/server.key -out certs/server.csr
+printf "subjectAltName=DNS:%s,DNS:localhost,IP:127.0.0.1\n" "$host" > certs/san.ext
+openssl x509 -req -in certs/server.csr -CA certs/ca.crt -CAkey certs/ca.key -CAcreateserial \
+  -days 3650 -extfile certs/san.ext -out certs/server.crt
+chmod 644 certs/server.key
+
+echo "cyd:$(openssl rand -hex 16)" > psk.txt
+
+cat > conf.d/tls.conf <<CONF
+listener 8883
+cafile /mosquitto/config/certs/ca.crt
+certfile /mosquitto/config/certs/server.crt
+keyfile /mosquitto/config/certs/server.key
+tls_version tlsv1.2
+
+listener 8884
+psk_hint cyd-mqtt
+psk_file /mosquitto/config/psk.txt
+tls_version tlsv1.2
+CONF
+
+echo "MQTT_TLS_CA_CERT: config/certs/ca.crt"
+echo "MQTT_TLS_PSK_IDENTITY/KEY: $(cat psk.txt)"